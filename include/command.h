@@ -0,0 +1,41 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Evict is a DEL the leader issues to stay within maxmemory. It is replicated
+// and logged like any write, but clients cannot send it.
+enum class OpCode : uint8_t { Set, Get, Del, Keys, Evict, Count };
+
+// A client command parsed once, on the node that receives it. Replicas and
+// AOF replay work from this form and never tokenize command text again.
+// Key and value share one buffer: key bytes followed by value bytes.
+struct Command {
+    OpCode op{OpCode::Keys};
+    uint32_t key_size{0};
+    std::string payload;
+
+    Command() = default;
+    Command(OpCode op, std::string_view key, std::string_view value = {});
+
+    std::string_view key() const { return std::string_view(payload).substr(0, key_size); }
+    std::string_view value() const { return std::string_view(payload).substr(key_size); }
+    bool is_write() const { return op == OpCode::Set || op == OpCode::Del || op == OpCode::Evict; }
+};
+
+const char* op_name(OpCode op);
+
+// Parses a client command line ("SET key value", "GET \"a key\"", ...).
+// On failure returns false and sets error to the reply for the client.
+bool parse_command(const std::string& line, Command& command, std::string& error);
+
+// Length-prefixed binary form used in AppendEntries and the AOF:
+// "<op> <key size> <value size> <key><value>". No quoting or escaping.
+void encode_command(const Command& command, std::string& out);
+
+// Decodes one encoded command from the front of input and advances past it.
+bool decode_command(std::string_view& input, Command& command);
+
+#endif // COMMAND_H
@@ -0,0 +1,50 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Block codecs available for replication traffic, ordered from least to most
+// preferred. Which ones are compiled in depends on the libraries CMake found
+// (KV_HAVE_ZSTD / KV_HAVE_ZLIB).
+enum class Codec { None, Zlib, Zstd };
+
+const char* codec_name(Codec codec);
+Codec codec_from_name(const std::string& name);
+
+// Codecs this binary can decode, most preferred first.
+const std::vector<Codec>& supported_codecs();
+
+// Comma-separated list advertised to peers, e.g. "zstd,zlib" (or "none").
+std::string supported_codecs_string();
+
+// Picks the best codec from a peer's advertised list that we also support,
+// capped at our own preference. Returns Codec::None if nothing matches.
+Codec negotiate_codec(Codec preferred, const std::string& peer_codecs);
+
+// Counters are cumulative since process start.
+struct CompressionStats {
+    std::atomic<uint64_t> blocks_compressed{0};
+    std::atomic<uint64_t> blocks_skipped{0};   // compressed output was not smaller
+    std::atomic<uint64_t> blocks_decompressed{0};
+    std::atomic<uint64_t> raw_bytes{0};
+    std::atomic<uint64_t> compressed_bytes{0};
+    std::atomic<uint64_t> compress_us{0};
+    std::atomic<uint64_t> decompress_us{0};
+
+    std::string to_string() const;
+};
+
+CompressionStats& compression_stats();
+
+// Compresses input into output. Returns false if the codec is unavailable,
+// fails, or does not shrink the input; output is unspecified in that case.
+bool compress_block(Codec codec, const std::string& input, std::string& output);
+
+// Decompresses input into output, which must come out exactly raw_size bytes.
+bool decompress_block(Codec codec, std::string_view input, size_t raw_size, std::string& output);
+
+#endif // COMPRESSION_H
@@ -0,0 +1,85 @@
+#ifndef KV_CLIENT_H
+#define KV_CLIENT_H
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct KvClientOptions {
+    // Any subset of the cluster's "host:port" addresses; the leader is discovered from them.
+    std::vector<std::string> seeds;
+    // Connections kept open per node. Requests are pipelined on each connection.
+    size_t connections_per_node = 2;
+    // Attempts per request, counting redirects and reconnects.
+    int max_attempts = 10;
+    // Pause before retrying while the cluster has no known leader.
+    std::chrono::milliseconds retry_backoff{100};
+    // A reply not received within this time fails the request and its connection.
+    std::chrono::milliseconds request_timeout{2000};
+};
+
+// Asynchronous client for the replicated store. Caches the current leader,
+// follows NOT_LEADER redirects, retries through elections and pools
+// pipelined connections per node.
+//
+// All methods are coroutines and must be awaited from a single thread
+// (a single-threaded io_context or a strand); the client does no locking.
+// Delivery is at-least-once and not linearizable: a command whose connection
+// fails or times out is resent, and may then be applied twice if the first
+// attempt had already committed. A repeated DEL then returns 0, and a resent
+// SET can overwrite a newer value written by another client in between.
+// Redirects (NOT_LEADER, BUSY) are always safe to follow, since those
+// commands never reached the log; only lost connections and timeouts risk a
+// duplicate. A command that was logged but lost its leader before committing
+// is answered "ERR outcome unknown ..." and returned to the caller as is.
+class KvClient {
+public:
+    KvClient(boost::asio::io_context& io_context, KvClientOptions options);
+    ~KvClient();
+
+    // Sends a raw command line and returns the reply text, redirects resolved.
+    // Commands containing '\n' or '\r' throw std::invalid_argument, here and in execute_batch.
+    boost::asio::awaitable<std::string> execute(std::string command);
+
+    // Pipelines all commands on one leader connection and returns replies in order.
+    // Commands that get redirected are re-pipelined to the new leader and may
+    // then be applied after commands that follow them in the batch.
+    boost::asio::awaitable<std::vector<std::string>> execute_batch(std::vector<std::string> commands);
+
+    // Keys must be non-empty, and keys and values must not contain '"', '\n' or '\r'
+    // (the protocol has no escaping); otherwise these throw std::invalid_argument.
+    boost::asio::awaitable<std::optional<std::string>> get(const std::string& key);
+    boost::asio::awaitable<void> set(const std::string& key, const std::string& value);
+    boost::asio::awaitable<bool> del(const std::string& key);
+    boost::asio::awaitable<std::vector<std::string>> keys();
+
+    // Asks the leader to hand off leadership (-1 lets it pick the successor).
+    boost::asio::awaitable<void> transfer_leader(int target_id = -1);
+
+    // Address of the cached leader, empty if unknown.
+    const std::string& leader() const { return leader_; }
+
+    void close();
+
+private:
+    class Connection;
+
+    boost::asio::awaitable<std::shared_ptr<Connection>> acquire(const std::string& address);
+    void discard(const std::shared_ptr<Connection>& connection);
+    std::string next_seed();
+    // Returns the address to retry against, or empty if the reply is final.
+    // Sets backoff when the retry should wait (no known leader, or BUSY).
+    std::string redirect_target(const std::string& target, const std::string& reply, bool& backoff);
+
+    boost::asio::io_context& io_context_;
+    KvClientOptions options_;
+    std::string leader_;
+    size_t next_seed_{0};
+    std::map<std::string, std::vector<std::shared_ptr<Connection>>> pools_;
+};
+
+#endif // KV_CLIENT_H
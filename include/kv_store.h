@@ -1,26 +1,88 @@
 #ifndef KV_STORE_H
 #define KV_STORE_H
 
+#include "command.h"
+#include <cstdint>
 #include <fstream>
 #include <mutex>
+#include <random>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
+
+enum class EvictionPolicy { NoEviction, AllKeysLru, AllKeysLfu };
+
+const char* eviction_policy_name(EvictionPolicy policy);
+// Returns false if name is not a known policy.
+bool eviction_policy_from_name(const std::string& name, EvictionPolicy& policy);
 
 class KeyValueStore {
 public:
     explicit KeyValueStore(const std::string& aof_path);
-    
+
     // Applies a command to the in-memory store AND logs it to the AOF.
     // This is the single entry point for changing state.
-    std::string apply_command(const std::string& command);
+    std::string apply(const Command& command);
+
+    // Parses command text and applies it; for callers without a parsed Command.
+    std::string apply_command(const std::string& command_text);
+
+    // A max_memory of 0 means unlimited. The store itself never evicts: the
+    // Raft leader picks victims with select_evictions() and replicates DELs.
+    void set_memory_limit(size_t max_memory, EvictionPolicy policy);
+    EvictionPolicy eviction_policy() const { return policy_; }
+    size_t max_memory() const { return max_memory_; }
+    size_t used_memory();
+
+    // Samples the keyspace and returns keys whose removal frees at least
+    // bytes_to_free, best eviction candidates first.
+    std::vector<std::string> select_evictions(size_t bytes_to_free);
+
+    std::string memory_info();
 
 private:
+    // Key, value and bookkeeping; an estimate of what one entry costs in memory.
+    struct Entry {
+        std::string value;
+        uint64_t last_access{0}; // logical access clock, for LRU
+        uint8_t frequency{0};    // logarithmic access counter, for LFU
+    };
+
+    // Lets lookups take a std::string_view key without building a std::string.
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view key) const { return std::hash<std::string_view>()(key); }
+    };
+
+    // One handler per OpCode; apply() dispatches through this table.
+    using Handler = std::string (KeyValueStore::*)(const Command&);
+    static const Handler kHandlers[];
+
+    std::string apply_set(const Command& command);
+    std::string apply_get(const Command& command);
+    std::string apply_del(const Command& command);
+    std::string apply_keys(const Command& command);
+    std::string apply_evict(const Command& command);
+
     void load_from_aof();
+    void set_value(std::string_view key, std::string_view value);
+    bool erase_key(std::string_view key);
+    void touch(Entry& entry);
+    uint8_t decayed_frequency(const Entry& entry) const;
+    static size_t footprint(std::string_view key, std::string_view value);
 
-    std::unordered_map<std::string, std::string> store_;
+    std::unordered_map<std::string, Entry, KeyHash, std::equal_to<>> store_;
     std::string aof_path_;
     std::mutex mutex_;
+
+    size_t max_memory_{0};
+    EvictionPolicy policy_{EvictionPolicy::NoEviction};
+    size_t used_memory_{0};
+    // Keys removed by EVICT entries applied since startup; AOF replay is not counted.
+    uint64_t evicted_keys_{0};
+    uint64_t access_clock_{0};
+    std::mt19937 rng_{std::random_device{}()};
 };
 
 #endif // KV_STORE_H
-
@@ -1,6 +1,7 @@
 #ifndef RAFT_H
 #define RAFT_H
 
+#include "compression.h"
 #include "kv_store.h"
 #include <boost/asio.hpp>
 #include <chrono>
@@ -9,33 +10,89 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 
-enum class RaftState { Follower, Candidate, Leader };
+enum class RaftState { Follower, PreCandidate, Candidate, Leader };
+
+// Tunables for a single node. The defaults match the timings the cluster has
+// always used; they can be overridden from the server command line.
+struct RaftOptions {
+    int election_timeout_min_ms = 300;
+    int election_timeout_max_ms = 500;
+    int heartbeat_interval_ms = 150;
+    // Run a non-disruptive Pre-Vote round before bumping the term.
+    bool pre_vote = true;
+    // Leader steps down if it cannot reach a majority within an election timeout.
+    bool check_quorum = true;
+    // Most preferred codec for AppendEntries payloads; the codec actually used
+    // is negotiated with each peer. Codec::None disables compression.
+    Codec compression = Codec::Zstd;
+    // Payloads smaller than this are sent uncompressed.
+    size_t compression_threshold_bytes = 4096;
+    // Admission control: the leader answers BUSY instead of appending once this
+    // many entries, or this many command bytes, are waiting to commit.
+    size_t max_uncommitted_entries = 10000;
+    size_t max_uncommitted_bytes = 64 * 1024 * 1024;
+};
+
+// Receives the reply to a client request. The reply is taken by value so it
+// can be moved all the way into the session's write queue.
+using ReplyCallback = std::function<void(std::string)>;
 
 struct LogEntry {
     int term;
-    std::string command;
+    Command command;
 };
 
 class RaftNode : public std::enable_shared_from_this<RaftNode> {
 public:
+    // Upper bound on a single (decompressed) RPC, guards against bogus size headers.
+    static constexpr size_t kMaxRpcPayloadBytes = 256 * 1024 * 1024;
+
+    // Header line of a compressed AppendEntries frame,
+    // "AppendEntriesZ <codec> <raw size> <compressed size>"; the body follows it.
+    struct CompressedFrameHeader {
+        Codec codec{Codec::None};
+        size_t raw_size{0};
+        size_t compressed_size{0};
+    };
+    // Returns false if line is not a well-formed header.
+    static bool parse_compressed_header(std::string_view line, CompressedFrameHeader& header);
+
     RaftNode(int id, const std::vector<std::string>& peer_addresses,
-             KeyValueStore& store, boost::asio::io_context& io_context);
+             KeyValueStore& store, boost::asio::io_context& io_context,
+             const RaftOptions& options = RaftOptions());
 
     void start();
     void stop();
-    void submit_command(const std::string& command, std::function<void(const std::string&)> callback);
-    std::string handle_rpc(const std::string& request);
+    void submit_command(const std::string& command, ReplyCallback callback);
+    // Hands leadership to target_id (or the most up-to-date peer if -1).
+    // The callback receives "OK" once the target has been told to campaign.
+    void transfer_leadership(int target_id, ReplyCallback callback);
+    // Requests are read in place; neither call copies the request or its body.
+    std::string handle_rpc(std::string_view request);
+    std::string handle_compressed_rpc(const CompressedFrameHeader& header, std::string_view body);
+    // Node role, replication and store metrics for the INFO command.
+    std::string info();
 
 private:
     void reset_election_timer();
+    void start_pre_vote();
     void start_election();
     void become_leader();
     void broadcast_append_entries();
     void send_append_entries(int peer_index);
     void advance_commit_index();
+    void evict_if_needed();
     void step_down(int new_term);
+    bool check_quorum();
+    bool heard_from_leader_recently() const;
+    void send_timeout_now(int peer_index);
+    void finish_transfer(const std::string& result);
+    std::string not_leader_response() const;
+    // Follower side of AppendEntries; args is everything after the RPC name.
+    std::string handle_append_entries(std::string_view args);
     void send_rpc(const std::string& peer_address, const std::string& rpc_message, std::function<void(const std::string&)> callback);
 
     int id_;
@@ -51,9 +108,29 @@ private:
     std::vector<int> next_index_;
     std::vector<int> match_index_;
     int votes_received_{0};
+    int pre_votes_received_{0};
+
+    // Last time each peer answered an AppendEntries (leader only, for CheckQuorum)
+    std::vector<std::chrono::steady_clock::time_point> last_ack_;
+    // Codec agreed with each peer from its AppendEntries replies (leader only)
+    std::vector<Codec> peer_codec_;
+    // Last time we accepted an AppendEntries from the current leader
+    std::chrono::steady_clock::time_point last_leader_contact_;
+
+    // Leadership transfer in progress (-1 when idle)
+    int transfer_target_{-1};
+    bool timeout_now_sent_{false};
+    std::chrono::steady_clock::time_point transfer_deadline_;
+    ReplyCallback transfer_callback_;
     
-    std::map<int, std::function<void(const std::string&)>> client_callbacks_;
+    std::map<int, ReplyCallback> client_callbacks_;
+    // Command bytes in log_ past commit_index_ (leader only)
+    size_t uncommitted_bytes_{0};
+    // Index of the last EVICT entry appended (leader only); no new round starts
+    // until it has been applied, so the same keys are not picked twice.
+    int last_eviction_index_{0};
     
+    RaftOptions options_;
     KeyValueStore& kv_store_;
     std::vector<std::string> peer_addresses_;
     boost::asio::io_context& io_context_;
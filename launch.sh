@@ -19,6 +19,9 @@ LOG_DIR="server_logs"
 # See the README.md for examples.
 TERMINAL_LAUNCHER=${TERMINAL_LAUNCHER:-""}
 
+# Extra server options (e.g. "--heartbeat-interval=50") passed to every node.
+SERVER_ARGS=${SERVER_ARGS:-""}
+
 # --- Utility Functions ---
 build_peer_list() {
     local num_nodes=$1
@@ -40,13 +43,13 @@ launch_node() {
     echo " -> Launching Server $server_id on port $port (log: $log_file)..."
 
     if [ "$is_background" = "true" ]; then
-        local command_to_run="$EXECUTABLE $server_id $all_peers"
+        local command_to_run="$EXECUTABLE $SERVER_ARGS $server_id $all_peers"
         # nohup ensures the process isn't killed if the parent terminal closes.
         # Output is redirected to the log file.
         nohup $command_to_run > "$log_file" 2>&1 &
     else
         # Command will show output in terminal AND save it to a log file.
-        local full_command="$EXECUTABLE $server_id $all_peers 2>&1 | tee $log_file"
+        local full_command="$EXECUTABLE $SERVER_ARGS $server_id $all_peers 2>&1 | tee $log_file"
 
         if [ -n "$TERMINAL_LAUNCHER" ]; then
             # Use custom terminal launcher if set
@@ -132,7 +135,7 @@ case "$COMMAND" in
         fi
 
         echo "Stopping server $SERVER_ID..."
-        pkill -f "$EXECUTABLE $SERVER_ID " # Space prevents killing server 1 when restarting 10
+        pkill -f "$EXECUTABLE( --[^ ]+)* $SERVER_ID " # Space prevents killing server 1 when restarting 10
         sleep 1
         
         mkdir -p $LOG_DIR
@@ -0,0 +1,123 @@
+#include "command.h"
+#include <cctype>
+#include <charconv>
+
+// --- Helper Functions ---
+
+namespace {
+
+// Command names, indexed by OpCode.
+constexpr const char* kOpNames[] = {"SET", "GET", "DEL", "KEYS", "EVICT"};
+static_assert(sizeof(kOpNames) / sizeof(kOpNames[0]) == static_cast<size_t>(OpCode::Count));
+// Ops clients may send; the internal ones follow them in OpCode.
+constexpr size_t kClientOpCount = static_cast<size_t>(OpCode::Evict);
+
+void skip_whitespace(std::string_view& input) {
+    while (!input.empty() && std::isspace(static_cast<unsigned char>(input.front()))) input.remove_prefix(1);
+}
+
+// Parses a single argument from the front of input.
+// If the argument starts with a double quote, it reads until the matching closing quote.
+// Otherwise, it reads until the next whitespace character.
+std::string_view parse_argument(std::string_view& input) {
+    skip_whitespace(input);
+    std::string_view arg;
+
+    if (!input.empty() && input.front() == '"') {
+        input.remove_prefix(1); // Consume the opening quote
+        size_t end = input.find('"');
+        arg = input.substr(0, end);
+        input.remove_prefix(end == std::string_view::npos ? input.size() : end + 1);
+    } else {
+        size_t end = 0;
+        while (end < input.size() && !std::isspace(static_cast<unsigned char>(input[end]))) end++;
+        arg = input.substr(0, end);
+        input.remove_prefix(end);
+    }
+    return arg;
+}
+
+bool parse_size(std::string_view& input, size_t& value) {
+    auto [ptr, ec] = std::from_chars(input.data(), input.data() + input.size(), value);
+    if (ec != std::errc() || ptr == input.data() + input.size() || *ptr != ' ') return false;
+    input.remove_prefix(ptr - input.data() + 1);
+    return true;
+}
+
+} // namespace
+
+// --- Command Implementation ---
+
+Command::Command(OpCode op, std::string_view key, std::string_view value)
+    : op(op), key_size(key.size()) {
+    payload.reserve(key.size() + value.size());
+    payload.append(key);
+    payload.append(value);
+}
+
+const char* op_name(OpCode op) {
+    return op < OpCode::Count ? kOpNames[static_cast<size_t>(op)] : "UNKNOWN";
+}
+
+bool parse_command(const std::string& line, Command& command, std::string& error) {
+    std::string_view input(line);
+    std::string_view name = parse_argument(input);
+
+    size_t op_index = 0;
+    while (op_index < kClientOpCount && name != kOpNames[op_index]) op_index++;
+    if (op_index == kClientOpCount) {
+        error = "ERR unknown command '" + std::string(name) + "'\n";
+        return false;
+    }
+    OpCode op = static_cast<OpCode>(op_index);
+    if (op == OpCode::Keys) {
+        command = Command(op, {});
+        return true;
+    }
+
+    std::string_view key = parse_argument(input);
+    if (key.empty()) {
+        error = "ERR wrong number of arguments for '" + std::string(name) + "' command\n";
+        return false;
+    }
+
+    std::string_view value;
+    if (op == OpCode::Set) {
+        // The value is either quoted or everything remaining, spaces included
+        skip_whitespace(input);
+        if (!input.empty() && input.front() == '"') {
+            input.remove_prefix(1); // Consume quote
+            value = input.substr(0, input.find('"'));
+        } else {
+            value = input;
+        }
+    }
+    command = Command(op, key, value);
+    return true;
+}
+
+void encode_command(const Command& command, std::string& out) {
+    out += std::to_string(static_cast<int>(command.op));
+    out += ' ';
+    out += std::to_string(command.key_size);
+    out += ' ';
+    out += std::to_string(command.payload.size() - command.key_size);
+    out += ' ';
+    out += command.payload;
+}
+
+bool decode_command(std::string_view& input, Command& command) {
+    size_t op = 0, key_size = 0, value_size = 0;
+    if (!parse_size(input, op) || !parse_size(input, key_size) || !parse_size(input, value_size)) return false;
+    // Compare without adding the sizes, which could wrap around on a corrupt record.
+    if (op >= static_cast<size_t>(OpCode::Count) || key_size > UINT32_MAX || key_size > input.size() ||
+        value_size > input.size() - key_size) {
+        return false;
+    }
+
+    command.op = static_cast<OpCode>(op);
+    command.key_size = key_size;
+    command.payload.assign(input.substr(0, key_size + value_size));
+    input.remove_prefix(key_size + value_size);
+    return true;
+}
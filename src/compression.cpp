@@ -0,0 +1,169 @@
+#include "compression.h"
+#include <chrono>
+#include <sstream>
+
+#ifdef KV_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef KV_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+// Fast levels: replication latency matters more than the last few percent of ratio.
+constexpr int kZstdLevel = 1;
+constexpr int kZlibLevel = 1;
+
+uint64_t elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+const char* codec_name(Codec codec) {
+    switch (codec) {
+        case Codec::Zstd: return "zstd";
+        case Codec::Zlib: return "zlib";
+        default: return "none";
+    }
+}
+
+Codec codec_from_name(const std::string& name) {
+    if (name == "zstd") return Codec::Zstd;
+    if (name == "zlib") return Codec::Zlib;
+    return Codec::None;
+}
+
+const std::vector<Codec>& supported_codecs() {
+    static const std::vector<Codec> codecs = {
+#ifdef KV_HAVE_ZSTD
+        Codec::Zstd,
+#endif
+#ifdef KV_HAVE_ZLIB
+        Codec::Zlib,
+#endif
+    };
+    return codecs;
+}
+
+std::string supported_codecs_string() {
+    std::string result;
+    for (Codec codec : supported_codecs()) {
+        if (!result.empty()) result += ",";
+        result += codec_name(codec);
+    }
+    return result.empty() ? "none" : result;
+}
+
+Codec negotiate_codec(Codec preferred, const std::string& peer_codecs) {
+    if (preferred == Codec::None) return Codec::None;
+
+    std::stringstream ss(peer_codecs);
+    std::string name;
+    std::vector<Codec> offered;
+    while (std::getline(ss, name, ',')) {
+        offered.push_back(codec_from_name(name));
+    }
+
+    // supported_codecs() is ordered by preference; skip anything better than what was asked for.
+    for (Codec codec : supported_codecs()) {
+        if (codec > preferred) continue;
+        for (Codec peer_codec : offered) {
+            if (peer_codec == codec) return codec;
+        }
+    }
+    return Codec::None;
+}
+
+std::string CompressionStats::to_string() const {
+    uint64_t raw = raw_bytes.load();
+    uint64_t compressed = compressed_bytes.load();
+    std::stringstream ss;
+    ss << "compression_codecs:" << supported_codecs_string() << "\n"
+       << "compression_blocks_compressed:" << blocks_compressed.load() << "\n"
+       << "compression_blocks_skipped:" << blocks_skipped.load() << "\n"
+       << "compression_blocks_decompressed:" << blocks_decompressed.load() << "\n"
+       << "compression_raw_bytes:" << raw << "\n"
+       << "compression_compressed_bytes:" << compressed << "\n"
+       << "compression_ratio:" << (compressed ? (double)raw / compressed : 0.0) << "\n"
+       << "compression_cpu_us:" << compress_us.load() << "\n"
+       << "decompression_cpu_us:" << decompress_us.load() << "\n";
+    return ss.str();
+}
+
+CompressionStats& compression_stats() {
+    static CompressionStats stats;
+    return stats;
+}
+
+bool compress_block(Codec codec, const std::string& input, std::string& output) {
+    auto start = std::chrono::steady_clock::now();
+    bool ok = false;
+
+    switch (codec) {
+#ifdef KV_HAVE_ZSTD
+        case Codec::Zstd: {
+            output.resize(ZSTD_compressBound(input.size()));
+            size_t size = ZSTD_compress(output.data(), output.size(), input.data(), input.size(), kZstdLevel);
+            ok = !ZSTD_isError(size);
+            if (ok) output.resize(size);
+            break;
+        }
+#endif
+#ifdef KV_HAVE_ZLIB
+        case Codec::Zlib: {
+            uLongf size = compressBound(input.size());
+            output.resize(size);
+            ok = compress2(reinterpret_cast<Bytef*>(output.data()), &size,
+                           reinterpret_cast<const Bytef*>(input.data()), input.size(), kZlibLevel) == Z_OK;
+            if (ok) output.resize(size);
+            break;
+        }
+#endif
+        default:
+            return false;
+    }
+
+    auto& stats = compression_stats();
+    stats.compress_us += elapsed_us(start);
+    if (!ok || output.size() >= input.size()) {
+        stats.blocks_skipped++;
+        return false;
+    }
+    stats.blocks_compressed++;
+    stats.raw_bytes += input.size();
+    stats.compressed_bytes += output.size();
+    return true;
+}
+
+bool decompress_block(Codec codec, std::string_view input, size_t raw_size, std::string& output) {
+    auto start = std::chrono::steady_clock::now();
+    bool ok = false;
+    output.resize(raw_size);
+
+    switch (codec) {
+#ifdef KV_HAVE_ZSTD
+        case Codec::Zstd: {
+            size_t size = ZSTD_decompress(output.data(), output.size(), input.data(), input.size());
+            ok = !ZSTD_isError(size) && size == raw_size;
+            break;
+        }
+#endif
+#ifdef KV_HAVE_ZLIB
+        case Codec::Zlib: {
+            uLongf size = raw_size;
+            ok = uncompress(reinterpret_cast<Bytef*>(output.data()), &size,
+                            reinterpret_cast<const Bytef*>(input.data()), input.size()) == Z_OK && size == raw_size;
+            break;
+        }
+#endif
+        default:
+            return false;
+    }
+
+    auto& stats = compression_stats();
+    stats.decompress_us += elapsed_us(start);
+    if (ok) stats.blocks_decompressed++;
+    return ok;
+}
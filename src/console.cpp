@@ -1,8 +1,54 @@
+#include "kv_client.h"
 #include "kv_store.h"
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/use_future.hpp>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
+
+// Sends each line to a running cluster through KvClient, which finds the
+// leader and follows redirects, instead of applying it to a local store.
+int run_cluster_console(const std::vector<std::string>& seeds) {
+    boost::asio::io_context io_context;
+    auto work = boost::asio::make_work_guard(io_context);
+    KvClientOptions options;
+    options.seeds = seeds;
+    KvClient client(io_context, options);
+
+    // The client is single-threaded: all of its work runs on this one io thread.
+    std::thread io_thread([&io_context] { io_context.run(); });
+
+    std::cout << "C++ Key-Value Store CLI (cluster: " << seeds.front() << (seeds.size() > 1 ? ", ..." : "") << ")" << std::endl;
+    std::cout << "Commands: SET key value, GET key, DEL key, KEYS, TRANSFER_LEADER [id], INFO, EXIT" << std::endl;
+
+    std::string line;
+    while (std::cout << "> " && std::getline(std::cin, line) && line != "EXIT") {
+        if (line.empty()) continue;
+        try {
+            auto reply = boost::asio::co_spawn(io_context, client.execute(line), boost::asio::use_future);
+            std::cout << reply.get();
+        } catch (const std::exception& e) {
+            std::cout << "ERR " << e.what() << std::endl;
+        }
+    }
+
+    boost::asio::post(io_context, [&client] { client.close(); });
+    work.reset();
+    io_thread.join();
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        std::string mode = argv[1];
+        if (mode != "--cluster" || argc < 3) {
+            std::cerr << "Usage: " << argv[0] << " [--cluster <addr> [addr] ...]\n";
+            return 1;
+        }
+        return run_cluster_console(std::vector<std::string>(argv + 2, argv + argc));
+    }
 
-int main() {
     // The KeyValueStore now requires a path for its Append-Only File.
     // This gives our console a persistent state between runs.
     KeyValueStore kv_store("console_store.aof");
@@ -18,6 +64,6 @@ int main() {
             std::cout << kv_store.apply_command(line);
         }
     }
-        
+
     return 0;
 }
@@ -0,0 +1,425 @@
+#include "kv_client.h"
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <sstream>
+#include <stdexcept>
+
+using boost::asio::ip::tcp;
+using boost::asio::use_awaitable;
+
+namespace {
+
+std::string trim_newline(std::string reply) {
+    while (!reply.empty() && (reply.back() == '\n' || reply.back() == '\r')) reply.pop_back();
+    return reply;
+}
+
+bool starts_with(const std::string& s, const char* prefix) {
+    return s.rfind(prefix, 0) == 0;
+}
+
+// Replies of several lines start with a "*<line count>" header line.
+bool parse_line_count(const std::string& line, size_t& count) {
+    if (line.size() < 2 || line[0] != '*') return false;
+    auto [ptr, ec] = std::from_chars(line.data() + 1, line.data() + line.size(), count);
+    return ec == std::errc() && ptr == line.data() + line.size();
+}
+
+// Commands travel as single lines, so a line break would split one into two
+// and misalign every reply after it.
+void check_command(const std::string& command) {
+    if (command.find_first_of("\r\n") != std::string::npos) {
+        throw std::invalid_argument("kvclient: command contains a line break");
+    }
+}
+
+// Keys and values are sent quoted without escaping, so they cannot hold quotes either.
+void check_argument(const std::string& argument, const char* what) {
+    if (argument.find_first_of("\"\r\n") != std::string::npos) {
+        throw std::invalid_argument(std::string("kvclient: ") + what + " contains a quote or line break");
+    }
+}
+
+void check_key(const std::string& key) {
+    if (key.empty()) throw std::invalid_argument("kvclient: key is empty");
+    check_argument(key, "key");
+}
+
+} // namespace
+
+// One TCP connection to a node. Requests are written as soon as they are
+// queued (coalescing whatever piles up during a write) and matched to
+// replies in FIFO order by a single reader coroutine.
+class KvClient::Connection : public std::enable_shared_from_this<Connection> {
+public:
+    struct Pending {
+        explicit Pending(const boost::asio::any_io_executor& executor) : signal(executor) {}
+        bool done{false};
+        std::string reply;
+        boost::system::error_code error;
+        boost::asio::steady_timer signal;
+    };
+
+    Connection(boost::asio::io_context& io_context, std::string address)
+        : address_(std::move(address)), socket_(io_context) {}
+
+    const std::string& address() const { return address_; }
+    bool is_open() const { return open_; }
+    size_t in_flight() const { return pending_.size(); }
+
+    boost::asio::awaitable<void> connect() {
+        size_t colon_pos = address_.find(':');
+        if (colon_pos == std::string::npos) {
+            throw std::invalid_argument("kvclient: invalid address " + address_);
+        }
+        tcp::resolver resolver(socket_.get_executor());
+        auto endpoints = co_await resolver.async_resolve(address_.substr(0, colon_pos), address_.substr(colon_pos + 1), use_awaitable);
+        co_await boost::asio::async_connect(socket_, endpoints, use_awaitable);
+        socket_.set_option(tcp::no_delay(true));
+        open_ = true;
+        boost::asio::co_spawn(socket_.get_executor(), [self = shared_from_this()] { return self->read_loop(); }, boost::asio::detached);
+    }
+
+    std::shared_ptr<Pending> enqueue(const std::string& command) {
+        auto op = std::make_shared<Pending>(socket_.get_executor());
+        if (!open_) {
+            op->done = true;
+            op->error = boost::asio::error::not_connected;
+            return op;
+        }
+        pending_.push_back(op);
+        outbox_ += command;
+        outbox_ += "\n";
+        if (!writing_) {
+            writing_ = true;
+            boost::asio::co_spawn(socket_.get_executor(), [self = shared_from_this()] { return self->write_loop(); }, boost::asio::detached);
+        }
+        return op;
+    }
+
+    boost::asio::awaitable<std::string> wait(std::shared_ptr<Pending> op, std::chrono::milliseconds timeout) {
+        op->signal.expires_after(timeout);
+        while (!op->done) {
+            boost::system::error_code ec;
+            co_await op->signal.async_wait(boost::asio::redirect_error(use_awaitable, ec));
+            if (!ec && !op->done) {
+                // Replies are positional, so a lost one desynchronizes the whole connection.
+                close();
+                op->error = boost::asio::error::timed_out;
+            }
+        }
+        if (op->error) throw boost::system::system_error(op->error);
+        co_return op->reply;
+    }
+
+    void close() {
+        if (!open_) return;
+        open_ = false;
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+        fail_all(boost::asio::error::operation_aborted);
+    }
+
+private:
+    boost::asio::awaitable<void> write_loop() {
+        auto self = shared_from_this();
+        try {
+            while (!outbox_.empty() && open_) {
+                std::string batch;
+                batch.swap(outbox_);
+                co_await boost::asio::async_write(socket_, boost::asio::buffer(batch), use_awaitable);
+            }
+        } catch (const boost::system::system_error&) {
+            close();
+        }
+        writing_ = false;
+    }
+
+    boost::asio::awaitable<std::string> read_line() {
+        co_await boost::asio::async_read_until(socket_, buffer_, "\n", use_awaitable);
+        std::istream is(&buffer_);
+        std::string line;
+        std::getline(is, line);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        co_return line;
+    }
+
+    boost::asio::awaitable<void> read_loop() {
+        auto self = shared_from_this();
+        try {
+            while (open_) {
+                std::string line = co_await read_line();
+                if (pending_.empty()) break; // unsolicited data, protocol error
+
+                auto op = pending_.front();
+                size_t line_count = 0;
+                if (parse_line_count(line, line_count)) {
+                    op->reply.clear();
+                    for (size_t i = 0; i < line_count; ++i) {
+                        std::string next = co_await read_line();
+                        op->reply += next + "\n";
+                    }
+                } else {
+                    op->reply = line + "\n";
+                }
+                pending_.pop_front();
+                op->done = true;
+                op->signal.cancel();
+            }
+        } catch (const boost::system::system_error&) {
+        }
+        close();
+    }
+
+    void fail_all(boost::system::error_code ec) {
+        while (!pending_.empty()) {
+            auto op = pending_.front();
+            pending_.pop_front();
+            op->done = true;
+            op->error = ec;
+            op->signal.cancel();
+        }
+    }
+
+    std::string address_;
+    tcp::socket socket_;
+    boost::asio::streambuf buffer_;
+    std::deque<std::shared_ptr<Pending>> pending_;
+    std::string outbox_;
+    bool writing_{false};
+    bool open_{false};
+};
+
+// --- KvClient Implementation ---
+
+KvClient::KvClient(boost::asio::io_context& io_context, KvClientOptions options)
+    : io_context_(io_context), options_(std::move(options)) {
+    if (options_.seeds.empty()) {
+        throw std::invalid_argument("kvclient: at least one seed address is required");
+    }
+    if (options_.connections_per_node == 0) options_.connections_per_node = 1;
+}
+
+KvClient::~KvClient() {
+    close();
+}
+
+void KvClient::close() {
+    for (auto& [address, pool] : pools_) {
+        for (auto& connection : pool) connection->close();
+    }
+    pools_.clear();
+}
+
+std::string KvClient::next_seed() {
+    return options_.seeds[next_seed_++ % options_.seeds.size()];
+}
+
+boost::asio::awaitable<std::shared_ptr<KvClient::Connection>> KvClient::acquire(const std::string& address) {
+    auto& pool = pools_[address];
+    std::erase_if(pool, [](const auto& connection) { return !connection->is_open(); });
+
+    std::shared_ptr<Connection> least_busy;
+    for (auto& connection : pool) {
+        if (!least_busy || connection->in_flight() < least_busy->in_flight()) least_busy = connection;
+    }
+    if (least_busy && (least_busy->in_flight() == 0 || pool.size() >= options_.connections_per_node)) {
+        co_return least_busy;
+    }
+
+    auto connection = std::make_shared<Connection>(io_context_, address);
+    co_await connection->connect();
+    pools_[address].push_back(connection);
+    co_return connection;
+}
+
+void KvClient::discard(const std::shared_ptr<Connection>& connection) {
+    connection->close();
+    std::erase(pools_[connection->address()], connection);
+}
+
+std::string KvClient::redirect_target(const std::string& target, const std::string& reply, bool& backoff) {
+    if (starts_with(reply, "NOT_LEADER")) {
+        std::string address = trim_newline(reply.substr(10));
+        size_t start = address.find_first_not_of(' ');
+        leader_ = start == std::string::npos ? "" : address.substr(start);
+        if (!leader_.empty()) return leader_;
+        // No known leader means an election is under way: give it time, then try another node.
+        backoff = true;
+        return next_seed();
+    }
+    if (starts_with(reply, "ERR leadership transfer in progress")) {
+        leader_.clear();
+        backoff = true;
+        return next_seed();
+    }
+    if (starts_with(reply, "BUSY")) {
+        // The leader is shedding load; retry it once the backlog has had time to drain.
+        leader_ = target;
+        backoff = true;
+        return target;
+    }
+    return "";
+}
+
+boost::asio::awaitable<std::string> KvClient::execute(std::string command) {
+    check_command(command);
+    std::string target = leader_.empty() ? next_seed() : leader_;
+    boost::asio::steady_timer backoff(io_context_);
+
+    for (int attempt = 0; attempt < options_.max_attempts; ++attempt) {
+        bool wait_before_retry = false;
+        try {
+            auto connection = co_await acquire(target);
+            std::string reply = co_await connection->wait(connection->enqueue(command), options_.request_timeout);
+
+            std::string redirect = redirect_target(target, reply, wait_before_retry);
+            if (redirect.empty()) {
+                leader_ = target;
+                co_return reply;
+            }
+            target = redirect;
+        } catch (const boost::system::system_error&) {
+            if (auto it = pools_.find(target); it != pools_.end()) {
+                std::erase_if(it->second, [](const auto& connection) { return !connection->is_open(); });
+            }
+            leader_.clear();
+            target = next_seed();
+            wait_before_retry = true;
+        }
+
+        if (wait_before_retry) {
+            backoff.expires_after(options_.retry_backoff);
+            co_await backoff.async_wait(use_awaitable);
+        }
+    }
+    throw std::runtime_error("kvclient: request failed after " + std::to_string(options_.max_attempts) + " attempts");
+}
+
+boost::asio::awaitable<std::vector<std::string>> KvClient::execute_batch(std::vector<std::string> commands) {
+    for (const auto& command : commands) check_command(command);
+    std::vector<std::string> replies(commands.size());
+    std::vector<size_t> remaining(commands.size());
+    for (size_t i = 0; i < remaining.size(); ++i) remaining[i] = i;
+
+    std::string target = leader_.empty() ? next_seed() : leader_;
+    boost::asio::steady_timer backoff(io_context_);
+
+    // Only rounds that complete nothing count against max_attempts, so a large
+    // batch trickling through a BUSY leader still finishes.
+    int failed_rounds = 0;
+    while (!remaining.empty() && failed_rounds < options_.max_attempts) {
+        std::vector<size_t> retry;
+        bool wait_before_retry = false;
+
+        std::shared_ptr<Connection> connection;
+        try {
+            connection = co_await acquire(target);
+        } catch (const boost::system::system_error&) {
+        }
+
+        if (connection) {
+            std::vector<std::shared_ptr<Connection::Pending>> ops;
+            ops.reserve(remaining.size());
+            for (size_t i : remaining) ops.push_back(connection->enqueue(commands[i]));
+
+            std::string redirect;
+            for (size_t k = 0; k < ops.size(); ++k) {
+                try {
+                    std::string reply = co_await connection->wait(ops[k], options_.request_timeout);
+                    std::string next = redirect_target(target, reply, wait_before_retry);
+                    if (next.empty()) {
+                        replies[remaining[k]] = std::move(reply);
+                        continue;
+                    }
+                    redirect = next;
+                } catch (const boost::system::system_error&) {
+                }
+                retry.push_back(remaining[k]);
+            }
+
+            if (!connection->is_open()) {
+                discard(connection);
+                connection.reset();
+            } else if (!redirect.empty()) {
+                // Resend everything that was redirected to the new target in one pipeline.
+                target = redirect;
+            } else {
+                leader_ = target;
+            }
+        }
+        if (!connection) {
+            leader_.clear();
+            target = next_seed();
+            wait_before_retry = true;
+        }
+
+        if (retry.size() == remaining.size()) failed_rounds++;
+        remaining.swap(retry);
+        if (wait_before_retry && !remaining.empty()) {
+            backoff.expires_after(options_.retry_backoff);
+            co_await backoff.async_wait(use_awaitable);
+        }
+    }
+    if (!remaining.empty()) {
+        throw std::runtime_error("kvclient: request failed after " + std::to_string(options_.max_attempts) + " attempts");
+    }
+    co_return replies;
+}
+
+// --- Typed Helpers ---
+
+boost::asio::awaitable<std::optional<std::string>> KvClient::get(const std::string& key) {
+    check_key(key);
+    std::string reply = trim_newline(co_await execute("GET \"" + key + "\""));
+    if (reply == "(nil)") co_return std::nullopt;
+    if (reply.size() >= 2 && reply.front() == '"' && reply.back() == '"') {
+        co_return reply.substr(1, reply.size() - 2);
+    }
+    throw std::runtime_error("kvclient: GET failed: " + reply);
+}
+
+boost::asio::awaitable<void> KvClient::set(const std::string& key, const std::string& value) {
+    check_key(key);
+    check_argument(value, "value");
+    std::string reply = trim_newline(co_await execute("SET \"" + key + "\" \"" + value + "\""));
+    if (reply != "OK") throw std::runtime_error("kvclient: SET failed: " + reply);
+}
+
+boost::asio::awaitable<bool> KvClient::del(const std::string& key) {
+    check_key(key);
+    std::string reply = trim_newline(co_await execute("DEL \"" + key + "\""));
+    if (reply != "0" && reply != "1") throw std::runtime_error("kvclient: DEL failed: " + reply);
+    co_return reply == "1";
+}
+
+boost::asio::awaitable<std::vector<std::string>> KvClient::keys() {
+    std::string reply = co_await execute("KEYS");
+    std::vector<std::string> result;
+    if (starts_with(reply, "(empty")) co_return result;
+    if (starts_with(reply, "ERR")) throw std::runtime_error("kvclient: KEYS failed: " + trim_newline(reply));
+
+    // Lines look like: 1) "key"
+    std::stringstream ss(reply);
+    std::string line;
+    while (std::getline(ss, line)) {
+        size_t open = line.find('"');
+        size_t close = line.rfind('"');
+        if (open != std::string::npos && close > open) result.push_back(line.substr(open + 1, close - open - 1));
+    }
+    co_return result;
+}
+
+boost::asio::awaitable<void> KvClient::transfer_leader(int target_id) {
+    std::string command = "TRANSFER_LEADER";
+    if (target_id >= 0) command += " " + std::to_string(target_id);
+    std::string reply = trim_newline(co_await execute(command));
+    if (reply != "OK") throw std::runtime_error("kvclient: TRANSFER_LEADER failed: " + reply);
+    // The old leader will start redirecting shortly; rediscover on the next request.
+    leader_.clear();
+}
@@ -1,139 +1,287 @@
 #include "kv_store.h"
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <iterator>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
+// --- Eviction Tuning ---
+
+// Keys sampled per eviction pick; 5 gets close to true LRU/LFU at a fraction of the cost.
+constexpr int kEvictionSamples = 5;
+// Bucket probes allowed per pick before falling back to a full scan.
+constexpr int kEvictionMaxProbes = kEvictionSamples * 16;
+// LFU counter: new keys start here so they are not evicted before a second access,
+// and each increment gets logarithmically less likely.
+constexpr uint8_t kLfuInitialFrequency = 5;
+constexpr double kLfuLogFactor = 10.0;
+// The LFU counter of an idle key drops by one every this many store accesses.
+constexpr uint64_t kLfuDecayTicks = 10000;
+
 // --- Helper Functions ---
 
-// Parses a single argument from the string stream.
-// If the argument starts with a double quote, it reads until the matching closing quote.
-// Otherwise, it reads until the next whitespace character.
-std::string parse_argument(std::stringstream& ss) {
-    std::string arg;
-    ss >> std::ws; // Consume leading whitespace
+// Starts every length-prefixed AOF record; older quoted-text lines never do.
+constexpr char kAofRecordMarker = '@';
 
-    if (ss.peek() == '"') {
-        ss.get(); // Consume the opening quote
-        std::getline(ss, arg, '"'); // Read everything until the closing quote
-    } else {
-        ss >> arg; // Read until the next whitespace
+const char* eviction_policy_name(EvictionPolicy policy) {
+    switch (policy) {
+        case EvictionPolicy::AllKeysLru: return "allkeys-lru";
+        case EvictionPolicy::AllKeysLfu: return "allkeys-lfu";
+        default: return "noeviction";
     }
-    return arg;
+}
+
+bool eviction_policy_from_name(const std::string& name, EvictionPolicy& policy) {
+    for (EvictionPolicy candidate : {EvictionPolicy::NoEviction, EvictionPolicy::AllKeysLru, EvictionPolicy::AllKeysLfu}) {
+        if (name == eviction_policy_name(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
 }
 
 // --- KeyValueStore Implementation ---
 
+// Command handlers, indexed by OpCode.
+const KeyValueStore::Handler KeyValueStore::kHandlers[] = {
+    &KeyValueStore::apply_set,
+    &KeyValueStore::apply_get,
+    &KeyValueStore::apply_del,
+    &KeyValueStore::apply_keys,
+    &KeyValueStore::apply_evict,
+};
+
 KeyValueStore::KeyValueStore(const std::string& aof_path) : aof_path_(aof_path) {
     std::cout << "Initializing KeyValueStore with AOF: " << aof_path_ << std::endl;
     load_from_aof();
 }
 
 void KeyValueStore::load_from_aof() {
-    std::ifstream aof_file(aof_path_);
+    std::ifstream aof_file(aof_path_, std::ios::binary);
     if (!aof_file.is_open()) {
         std::cout << "AOF file not found. Starting with an empty state." << std::endl;
         return;
     }
 
     std::cout << "Loading commands from " << aof_path_ << "..." << std::endl;
-    std::string line;
+    std::string contents((std::istreambuf_iterator<char>(aof_file)), std::istreambuf_iterator<char>());
+    std::string_view input(contents);
     int commands_replayed = 0;
-    while (std::getline(aof_file, line)) {
-        if (line.empty()) continue;
-        
-        // Apply command to in-memory store, but do not re-write to AOF.
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::stringstream ss(line);
-        std::string command = parse_argument(ss);
-
-        if (command == "SET") {
-            std::string key = parse_argument(ss);
-            std::string value = parse_argument(ss);
-            if (!key.empty()) { // Value can be empty
-                store_[key] = value;
-            }
-        } else if (command == "DEL") {
-            std::string key = parse_argument(ss);
-            if (!key.empty()) {
-                store_.erase(key);
+    Command command;
+    std::string error;
+
+    // Apply commands to the in-memory store, but do not re-write them to the AOF.
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!input.empty()) {
+        if (input.front() == '\n') {
+            input.remove_prefix(1);
+            continue;
+        }
+        if (input.front() == kAofRecordMarker) {
+            input.remove_prefix(1);
+            if (!decode_command(input, command) || input.empty() || input.front() != '\n') {
+                std::cerr << "Truncated or corrupt AOF record after " << commands_replayed << " commands; ignoring the rest." << std::endl;
+                break;
             }
+        } else {
+            // Quoted text written by older versions
+            size_t end = input.find('\n');
+            std::string line(input.substr(0, end));
+            input.remove_prefix(end == std::string_view::npos ? input.size() : end);
+            if (!parse_command(line, command, error)) continue;
+        }
+        if (command.op == OpCode::Evict) {
+            // Not counted in evicted_keys_: the Raft log is not persisted, so the
+            // leader re-sends these entries after a restart and they are counted then.
+            erase_key(command.key());
+        } else if (command.is_write()) {
+            (this->*kHandlers[static_cast<size_t>(command.op)])(command);
         }
         commands_replayed++;
     }
     std::cout << "Replayed " << commands_replayed << " commands from AOF." << std::endl;
 }
 
-std::string KeyValueStore::apply_command(const std::string& command) {
+std::string KeyValueStore::apply_command(const std::string& command_text) {
+    Command command;
+    std::string error;
+    if (!parse_command(command_text, command, error)) {
+        return error;
+    }
+    return apply(command);
+}
+
+std::string KeyValueStore::apply(const Command& command) {
+    static_assert(std::size(kHandlers) == static_cast<size_t>(OpCode::Count), "one handler per OpCode");
+    if (command.op >= OpCode::Count) {
+        return "ERR unknown command\n";
+    }
     std::lock_guard<std::mutex> lock(mutex_);
-    
-    std::stringstream ss(command);
-    std::string command_type = parse_argument(ss);
-
-    if (command_type == "SET") {
-        std::string key = parse_argument(ss);
-        std::string value;
-
-        // Special handling for value to capture everything remaining, even with spaces
-        ss >> std::ws;
-        if (ss.peek() == '"') {
-             ss.get(); // Consume quote
-             std::getline(ss, value, '"');
-        } else {
-             std::getline(ss, value);
-        }
+    if (command.is_write()) {
+        // Persist to the AOF before applying to memory
+        std::string record(1, kAofRecordMarker);
+        encode_command(command, record);
+        record += '\n';
+        std::ofstream aof_file(aof_path_, std::ios::app | std::ios::binary);
+        aof_file << record << std::flush;
+    }
+    return (this->*kHandlers[static_cast<size_t>(command.op)])(command);
+}
 
-        if (key.empty()) {
-            return "ERR wrong number of arguments for 'SET' command\n";
-        }
-        
-        // Persist to AOF in a canonical, quoted format before applying to memory
-        std::string canonical_command = "SET \"" + key + "\" \"" + value + "\"";
-        std::ofstream aof_file(aof_path_, std::ios::app);
-        aof_file << canonical_command << std::endl;
-
-        store_[key] = value;
-        return "OK\n";
-
-    } else if (command_type == "GET") {
-        std::string key = parse_argument(ss);
-        if (key.empty()) {
-             return "ERR wrong number of arguments for 'GET' command\n";
-        }
-        if (store_.count(key)) {
-            return "\"" + store_.at(key) + "\"\n";
-        } else {
-            return "(nil)\n";
-        }
-    } else if (command_type == "DEL") {
-        std::string key = parse_argument(ss);
-        if (key.empty()) {
-             return "ERR wrong number of arguments for 'DEL' command\n";
+// --- Command Handlers ---
+// Called WITH THE MUTEX HELD, through kHandlers.
+
+std::string KeyValueStore::apply_set(const Command& command) {
+    set_value(command.key(), command.value());
+    return "OK\n";
+}
+
+std::string KeyValueStore::apply_get(const Command& command) {
+    auto it = store_.find(command.key());
+    if (it == store_.end()) {
+        return "(nil)\n";
+    }
+    touch(it->second);
+    std::string reply;
+    reply.reserve(it->second.value.size() + 3);
+    reply += '"';
+    reply += it->second.value;
+    reply += "\"\n";
+    return reply;
+}
+
+std::string KeyValueStore::apply_del(const Command& command) {
+    return erase_key(command.key()) ? "1\n" : "0\n";
+}
+
+std::string KeyValueStore::apply_evict(const Command& command) {
+    if (!erase_key(command.key())) return "0\n";
+    evicted_keys_++;
+    return "1\n";
+}
+
+std::string KeyValueStore::apply_keys(const Command&) {
+    if (store_.empty()) {
+        return "(empty list or set)\n";
+    }
+    std::string result;
+    int i = 1;
+    for (const auto& pair : store_) {
+        result += std::to_string(i++) + ") \"" + pair.first + "\"\n";
+    }
+    return result;
+}
+
+// --- Memory Accounting & Eviction ---
+
+size_t KeyValueStore::footprint(std::string_view key, std::string_view value) {
+    // Hash node (pair plus next pointer and cached hash) and the string payloads.
+    return sizeof(std::pair<const std::string, Entry>) + 2 * sizeof(void*) + key.size() + value.size();
+}
+
+void KeyValueStore::set_value(std::string_view key, std::string_view value) {
+    // This function is called WITH THE MUTEX HELD.
+    auto it = store_.find(key);
+    if (it == store_.end()) {
+        it = store_.emplace(std::string(key), Entry{}).first;
+        it->second.frequency = kLfuInitialFrequency;
+    } else {
+        used_memory_ -= footprint(key, it->second.value);
+    }
+    it->second.value.assign(value);
+    used_memory_ += footprint(key, it->second.value);
+    touch(it->second);
+}
+
+bool KeyValueStore::erase_key(std::string_view key) {
+    // This function is called WITH THE MUTEX HELD.
+    auto it = store_.find(key);
+    if (it == store_.end()) return false;
+    used_memory_ -= footprint(key, it->second.value);
+    store_.erase(it);
+    return true;
+}
+
+void KeyValueStore::touch(Entry& entry) {
+    // This function is called WITH THE MUTEX HELD.
+    entry.frequency = decayed_frequency(entry);
+    if (entry.frequency < UINT8_MAX) {
+        double base = entry.frequency > kLfuInitialFrequency ? entry.frequency - kLfuInitialFrequency : 0;
+        if (std::uniform_real_distribution<>(0.0, 1.0)(rng_) < 1.0 / (base * kLfuLogFactor + 1.0)) {
+            entry.frequency++;
         }
+    }
+    entry.last_access = ++access_clock_;
+}
 
-        // Persist to AOF in a canonical, quoted format before applying to memory
-        std::string canonical_command = "DEL \"" + key + "\"";
-        std::ofstream aof_file(aof_path_, std::ios::app);
-        aof_file << canonical_command << std::endl;
+uint8_t KeyValueStore::decayed_frequency(const Entry& entry) const {
+    // This function is called WITH THE MUTEX HELD.
+    uint64_t periods = (access_clock_ - entry.last_access) / kLfuDecayTicks;
+    return periods >= entry.frequency ? 0 : entry.frequency - periods;
+}
 
-        if (store_.erase(key)) {
-            return "1\n";
-        } else {
-            return "0\n";
+void KeyValueStore::set_memory_limit(size_t max_memory, EvictionPolicy policy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_memory_ = max_memory;
+    policy_ = policy;
+}
+
+size_t KeyValueStore::used_memory() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_memory_;
+}
+
+std::vector<std::string> KeyValueStore::select_evictions(size_t bytes_to_free) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> victims;
+    if (policy_ == EvictionPolicy::NoEviction || store_.empty()) return victims;
+
+    using Node = std::pair<const std::string, Entry>;
+    auto better_victim = [this](const Node& a, const Node& b) {
+        if (policy_ == EvictionPolicy::AllKeysLfu) {
+            uint8_t fa = decayed_frequency(a.second), fb = decayed_frequency(b.second);
+            if (fa != fb) return fa < fb;
         }
-    } else if (command_type == "KEYS") {
-        if (store_.empty()) {
-            return "(empty list or set)\n";
+        return a.second.last_access < b.second.last_access;
+    };
+
+    std::unordered_set<const Node*> chosen;
+    std::uniform_int_distribution<size_t> bucket_dist(0, store_.bucket_count() - 1);
+    size_t freed = 0;
+
+    while (freed < bytes_to_free && chosen.size() < store_.size()) {
+        // Sample a few keys by probing random buckets and keep the best candidate.
+        const Node* best = nullptr;
+        int sampled = 0;
+        for (int probes = 0; sampled < kEvictionSamples && probes < kEvictionMaxProbes; ++probes) {
+            size_t bucket = bucket_dist(rng_);
+            for (auto it = store_.begin(bucket); it != store_.end(bucket) && sampled < kEvictionSamples; ++it) {
+                if (chosen.count(&*it)) continue;
+                sampled++;
+                if (!best || better_victim(*it, *best)) best = &*it;
+            }
         }
-        std::string result;
-        int i = 1;
-        for (const auto& pair : store_) {
-            result += std::to_string(i++) + ") \"" + pair.first + "\"\n";
+        if (!best) {
+            // Almost everything is already chosen; finish with a scan.
+            for (const auto& node : store_) {
+                if (!chosen.count(&node) && (!best || better_victim(node, *best))) best = &node;
+            }
         }
-        return result;
+
+        chosen.insert(best);
+        victims.push_back(best->first);
+        freed += footprint(best->first, best->second.value);
     }
-    
-    return "ERR unknown command '" + command_type + "'\n";
+    return victims;
 }
 
+std::string KeyValueStore::memory_info() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return "used_memory:" + std::to_string(used_memory_) + "\n" +
+           "maxmemory:" + std::to_string(max_memory_) + "\n" +
+           "maxmemory_policy:" + eviction_policy_name(policy_) + "\n" +
+           "keys:" + std::to_string(store_.size()) + "\n" +
+           "evicted_keys:" + std::to_string(evicted_keys_) + "\n";
+}
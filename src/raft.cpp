@@ -3,6 +3,7 @@
 #include <boost/asio/detached.hpp>
 #include <boost/asio/post.hpp>
 #include <boost/asio/use_awaitable.hpp>
+#include <charconv>
 #include <iostream>
 #include <random>
 #include <sstream>
@@ -11,14 +12,16 @@
 using boost::asio::ip::tcp;
 
 RaftNode::RaftNode(int id, const std::vector<std::string>& peer_addresses,
-                   KeyValueStore& store, boost::asio::io_context& io_context)
+                   KeyValueStore& store, boost::asio::io_context& io_context,
+                   const RaftOptions& options)
     : id_(id),
+      options_(options),
       kv_store_(store),
       peer_addresses_(peer_addresses),
       io_context_(io_context),
       election_timer_(io_context),
       heartbeat_timer_(io_context) {
-    log_.push_back({0, ""}); // Sentinel entry
+    log_.push_back({0, Command()}); // Sentinel entry
 }
 
 void RaftNode::start() {
@@ -35,18 +38,72 @@ void RaftNode::stop() {
 void RaftNode::reset_election_timer() {
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(300, 500);
+    std::uniform_int_distribution<> distrib(options_.election_timeout_min_ms, options_.election_timeout_max_ms);
     election_timer_.expires_after(std::chrono::milliseconds(distrib(gen)));
     election_timer_.async_wait([this, self = shared_from_this()](const boost::system::error_code& ec) {
         if (!ec) {
             std::lock_guard<std::mutex> lock(mutex_);
             if (state_ != RaftState::Leader) {
-                start_election();
+                if (options_.pre_vote) {
+                    start_pre_vote();
+                } else {
+                    start_election();
+                }
             }
         }
     });
 }
 
+void RaftNode::start_pre_vote() {
+    // This function is called WITH THE MUTEX HELD.
+    // Ask the cluster whether it would vote for us in the next term, without
+    // touching current_term_. A node rejoining after a partition fails this
+    // round and so never forces a healthy leader to step down.
+    state_ = RaftState::PreCandidate;
+    pre_votes_received_ = 1;
+    current_leader_id_ = -1;
+    const int proposed_term = current_term_ + 1;
+
+    std::cout << "[Node " << id_ << "] Timed out, starting pre-vote for term " << proposed_term << "." << std::endl;
+
+    if ((size_t)pre_votes_received_ > peer_addresses_.size() / 2) {
+        start_election();
+        return;
+    }
+
+    for (size_t i = 0; i < peer_addresses_.size(); ++i) {
+        if (i == (size_t)id_) continue;
+
+        std::stringstream rpc;
+        rpc << "PreVote " << proposed_term << " " << id_ << " " << (log_.size() - 1) << " " << log_.back().term << "\n";
+
+        send_rpc(peer_addresses_[i], rpc.str(), [this, self = shared_from_this(), proposed_term](const std::string& res) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (state_ != RaftState::PreCandidate || current_term_ + 1 != proposed_term) return;
+
+            if (res == "RPC_FAILED\n") return;
+
+            std::stringstream ss(res);
+            std::string result;
+            int term;
+            ss >> result >> term;
+
+            if (term > current_term_) {
+                step_down(term);
+                return;
+            }
+
+            if (result == "PreVoteGranted") {
+                pre_votes_received_++;
+                if ((size_t)pre_votes_received_ > peer_addresses_.size() / 2) {
+                    start_election();
+                }
+            }
+        });
+    }
+    reset_election_timer();
+}
+
 void RaftNode::start_election() {
     // This function is called WITH THE MUTEX HELD.
     state_ = RaftState::Candidate;
@@ -55,7 +112,12 @@ void RaftNode::start_election() {
     votes_received_ = 1;
     current_leader_id_ = -1;
 
-    std::cout << "[Node " << id_ << "] Timed out, starting election for term " << current_term_ << "." << std::endl;
+    std::cout << "[Node " << id_ << "] Starting election for term " << current_term_ << "." << std::endl;
+
+    if ((size_t)votes_received_ > peer_addresses_.size() / 2) {
+        become_leader();
+        return;
+    }
 
     for (size_t i = 0; i < peer_addresses_.size(); ++i) {
         if (i == (size_t)id_) continue;
@@ -101,6 +163,16 @@ void RaftNode::become_leader() {
 
     next_index_.assign(peer_addresses_.size(), log_.size());
     match_index_.assign(peer_addresses_.size(), 0);
+    // Every peer gets a full election timeout before CheckQuorum counts it as lost.
+    last_ack_.assign(peer_addresses_.size(), std::chrono::steady_clock::now());
+    // Start uncompressed until each peer advertises what it can decode.
+    peer_codec_.assign(peer_addresses_.size(), Codec::None);
+
+    last_eviction_index_ = 0;
+    uncommitted_bytes_ = 0;
+    for (size_t i = commit_index_ + 1; i < log_.size(); ++i) {
+        uncommitted_bytes_ += log_[i].command.payload.size();
+    }
 
     broadcast_append_entries();
 }
@@ -109,13 +181,24 @@ void RaftNode::broadcast_append_entries() {
     // This function is called WITH THE MUTEX HELD.
     if (state_ != RaftState::Leader) return;
 
+    if (options_.check_quorum && !check_quorum()) {
+        std::cout << "[Node " << id_ << "] Lost contact with a majority, stepping down." << std::endl;
+        step_down(current_term_);
+        return;
+    }
+
+    if (transfer_target_ != -1 && std::chrono::steady_clock::now() > transfer_deadline_) {
+        std::cout << "[Node " << id_ << "] Leadership transfer to node " << transfer_target_ << " timed out." << std::endl;
+        finish_transfer("ERR leadership transfer timed out\n");
+    }
+
     for (size_t i = 0; i < peer_addresses_.size(); ++i) {
         if (i != (size_t)id_) {
             send_append_entries(i);
         }
     }
 
-    heartbeat_timer_.expires_after(std::chrono::milliseconds(150));
+    heartbeat_timer_.expires_after(std::chrono::milliseconds(options_.heartbeat_interval_ms));
     heartbeat_timer_.async_wait([this, self = shared_from_this()](const boost::system::error_code& ec) {
         if (!ec) {
             std::lock_guard<std::mutex> lock(mutex_);
@@ -134,43 +217,65 @@ void RaftNode::send_append_entries(int peer_index) {
     int prev_log_index = next_index_[peer_index] - 1;
     int prev_log_term = log_[prev_log_index].term;
 
-    std::stringstream rpc;
-    rpc << "AppendEntries " << current_term_ << " " << id_ << " " << prev_log_index << " " << prev_log_term << " " << commit_index_;
+    std::string rpc_message = "AppendEntries " + std::to_string(current_term_) + " " + std::to_string(id_) + " " +
+                              std::to_string(prev_log_index) + " " + std::to_string(prev_log_term) + " " +
+                              std::to_string(commit_index_);
 
     size_t entries_to_send = log_.size() - next_index_[peer_index];
     for (size_t i = 0; i < entries_to_send; ++i) {
         const auto& entry = log_[next_index_[peer_index] + i];
-        // We add a separator character (\x01) to properly handle commands with spaces.
-        rpc << " " << entry.term << " " << entry.command << "\x01";
+        // Entries are length-prefixed, so keys and values may hold any bytes.
+        rpc_message += " " + std::to_string(entry.term) + " ";
+        encode_command(entry.command, rpc_message);
     }
-    rpc << "\n";
-    const std::string rpc_message = rpc.str();
-
-    // Release the lock before the async network call
-    boost::asio::post(io_context_, [this, self = shared_from_this(), peer_index, entries_to_send, rpc_message]() {
-        send_rpc(peer_addresses_[peer_index], rpc_message, [this, self, peer_index, entries_to_send](const std::string& response) {
+    rpc_message += "\n";
+    const Codec codec = rpc_message.size() >= options_.compression_threshold_bytes ? peer_codec_[peer_index] : Codec::None;
+    const int rpc_term = current_term_;
+
+    // Release the lock before compressing and making the async network call
+    boost::asio::post(io_context_, [this, self = shared_from_this(), peer_index, prev_log_index, entries_to_send, rpc_term, codec, rpc_message = std::move(rpc_message)]() mutable {
+        std::string compressed;
+        if (codec != Codec::None && compress_block(codec, rpc_message, compressed)) {
+            // Binary frame: a header line followed by exactly <compressed size> bytes.
+            rpc_message = "AppendEntriesZ " + std::string(codec_name(codec)) + " " + std::to_string(rpc_message.size()) +
+                          " " + std::to_string(compressed.size()) + "\n" + compressed;
+        }
+        send_rpc(peer_addresses_[peer_index], rpc_message, [this, self, peer_index, prev_log_index, entries_to_send, rpc_term](const std::string& response) {
             std::lock_guard<std::mutex> lock(mutex_);
-            if (state_ != RaftState::Leader) return;
+            if (state_ != RaftState::Leader || current_term_ != rpc_term) return;
 
             if (response == "RPC_FAILED\n") return;
 
             std::stringstream ss(response);
             std::string result;
             int term;
-            ss >> result >> term;
+            std::string codecs;
+            ss >> result >> term >> codecs;
 
             if (term > current_term_) {
                 step_down(term);
                 return;
             }
+            last_ack_[peer_index] = std::chrono::steady_clock::now();
+            if (codecs.rfind("codecs=", 0) == 0) {
+                peer_codec_[peer_index] = negotiate_codec(options_.compression, codecs.substr(7));
+            }
 
             if (result == "Success") {
-                next_index_[peer_index] = log_.size();
-                match_index_[peer_index] = next_index_[peer_index] - 1;
+                // Only what this RPC carried is known to match: the log may have
+                // grown, and other AppendEntries may have been answered, meanwhile.
+                int acked_index = prev_log_index + (int)entries_to_send;
+                match_index_[peer_index] = std::max(match_index_[peer_index], acked_index);
+                next_index_[peer_index] = std::max(next_index_[peer_index], acked_index + 1);
                 advance_commit_index();
-            } else {
+                if (peer_index == transfer_target_ && !timeout_now_sent_ && match_index_[peer_index] == (int)log_.size() - 1) {
+                    send_timeout_now(peer_index);
+                }
+            } else if (result == "Fail") {
                 next_index_[peer_index] = std::max(1, next_index_[peer_index] - 1);
             }
+            // DecodeFail says nothing about the peer's log: the codec renegotiated
+            // above is all that changes, and the same entries are sent again.
         });
     });
 }
@@ -198,32 +303,188 @@ void RaftNode::advance_commit_index() {
         while (last_applied_ < commit_index_) {
             last_applied_++;
             const auto& entry = log_[last_applied_];
-            std::string result = kv_store_.apply_command(entry.command);
+            std::string result = kv_store_.apply(entry.command);
+            uncommitted_bytes_ -= std::min(uncommitted_bytes_, entry.command.payload.size());
 
             if (client_callbacks_.count(last_applied_)) {
-                auto callback = client_callbacks_[last_applied_];
-                boost::asio::post(io_context_, [callback, result]() {
-                    callback(result);
+                auto callback = std::move(client_callbacks_[last_applied_]);
+                boost::asio::post(io_context_, [callback = std::move(callback), result = std::move(result)]() mutable {
+                    callback(std::move(result));
                 });
                 client_callbacks_.erase(last_applied_);
             }
         }
+        evict_if_needed();
+    }
+}
+
+void RaftNode::evict_if_needed() {
+    // This function is called WITH THE MUTEX HELD.
+    // Only the leader decides what to evict, and does so through the log, so
+    // every replica deletes the same keys in the same order.
+    if (state_ != RaftState::Leader || kv_store_.max_memory() == 0 ||
+        kv_store_.eviction_policy() == EvictionPolicy::NoEviction || last_eviction_index_ > commit_index_) {
+        return;
+    }
+    size_t used = kv_store_.used_memory();
+    if (used <= kv_store_.max_memory()) return;
+
+    std::vector<std::string> victims = kv_store_.select_evictions(used - kv_store_.max_memory());
+    for (const auto& key : victims) {
+        // Evictions bypass admission control: they are what frees the memory.
+        log_.push_back({current_term_, Command(OpCode::Evict, key)});
+        uncommitted_bytes_ += log_.back().command.payload.size();
+    }
+    if (!victims.empty()) {
+        last_eviction_index_ = log_.size() - 1;
+        std::cout << "[Node " << id_ << "] Memory over limit (" << used << " > " << kv_store_.max_memory()
+                  << " bytes), evicting " << victims.size() << " keys." << std::endl;
     }
 }
 
 void RaftNode::step_down(int new_term) {
     // This function is called WITH THE MUTEX HELD.
     state_ = RaftState::Follower;
-    current_term_ = new_term;
-    voted_for_ = -1;
+    if (new_term > current_term_) {
+        current_term_ = new_term;
+        voted_for_ = -1;
+    }
     current_leader_id_ = -1;
     heartbeat_timer_.cancel();
+    // Pending entries may already be on a majority and commit under the next
+    // leader, so this is not a redirect: resending could apply them twice.
+    for (auto& [index, callback] : client_callbacks_) {
+        boost::asio::post(io_context_, [callback = std::move(callback)]() {
+            callback("ERR outcome unknown: leadership lost before the command committed\n");
+        });
+    }
+    client_callbacks_.clear();
+    if (transfer_target_ != -1) {
+        // Losing leadership after TimeoutNow went out is the expected outcome.
+        finish_transfer(timeout_now_sent_ ? "OK\n" : "ERR leadership transfer aborted\n");
+    }
     reset_election_timer();
 }
 
-std::string RaftNode::handle_rpc(const std::string& request) {
+bool RaftNode::check_quorum() {
+    // This function is called WITH THE MUTEX HELD.
+    auto now = std::chrono::steady_clock::now();
+    auto window = std::chrono::milliseconds(options_.election_timeout_max_ms);
+    size_t active = 1;
+    for (size_t i = 0; i < peer_addresses_.size(); ++i) {
+        if (i != (size_t)id_ && now - last_ack_[i] <= window) {
+            active++;
+        }
+    }
+    return active > peer_addresses_.size() / 2;
+}
+
+bool RaftNode::heard_from_leader_recently() const {
+    // This function is called WITH THE MUTEX HELD.
+    if (state_ == RaftState::Leader) return true;
+    return current_leader_id_ != -1 &&
+           std::chrono::steady_clock::now() - last_leader_contact_ < std::chrono::milliseconds(options_.election_timeout_min_ms);
+}
+
+void RaftNode::send_timeout_now(int peer_index) {
+    // This function is called WITH THE MUTEX HELD.
+    timeout_now_sent_ = true;
+    std::cout << "[Node " << id_ << "] Node " << peer_index << " is caught up, sending TimeoutNow." << std::endl;
+
+    std::stringstream rpc;
+    rpc << "TimeoutNow " << current_term_ << " " << id_ << "\n";
+    const std::string rpc_message = rpc.str();
+
+    boost::asio::post(io_context_, [this, self = shared_from_this(), peer_index, rpc_message]() {
+        send_rpc(peer_addresses_[peer_index], rpc_message, [this, self, peer_index](const std::string& response) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (transfer_target_ != peer_index) return;
+            if (response.rfind("Ack", 0) == 0) {
+                finish_transfer("OK\n");
+            } else {
+                finish_transfer("ERR leadership transfer failed\n");
+            }
+        });
+    });
+}
+
+void RaftNode::finish_transfer(const std::string& result) {
+    // This function is called WITH THE MUTEX HELD.
+    auto callback = std::move(transfer_callback_);
+    transfer_callback_ = nullptr;
+    transfer_target_ = -1;
+    timeout_now_sent_ = false;
+    if (callback) {
+        boost::asio::post(io_context_, [callback, result]() { callback(result); });
+    }
+}
+
+std::string RaftNode::not_leader_response() const {
+    // This function is called WITH THE MUTEX HELD.
+    std::string response = "NOT_LEADER";
+    if (current_leader_id_ != -1 && current_leader_id_ < (int)peer_addresses_.size()) {
+        response += " " + peer_addresses_[current_leader_id_];
+    }
+    response += "\n";
+    return response;
+}
+
+namespace {
+
+// Parses a space-separated number from the front of input and advances past it.
+template <typename T>
+bool take_number(std::string_view& input, T& value) {
+    while (!input.empty() && input.front() == ' ') input.remove_prefix(1);
+    auto [ptr, ec] = std::from_chars(input.data(), input.data() + input.size(), value);
+    if (ec != std::errc()) return false;
+    input.remove_prefix(ptr - input.data());
+    return true;
+}
+
+} // namespace
+
+bool RaftNode::parse_compressed_header(std::string_view line, CompressedFrameHeader& header) {
+    constexpr std::string_view kPrefix = "AppendEntriesZ ";
+    if (line.rfind(kPrefix, 0) != 0) return false;
+    line.remove_prefix(kPrefix.size());
+    size_t codec_end = line.find(' ');
+    if (codec_end == std::string_view::npos) return false;
+    // Unknown names map to Codec::None, which decompress_block rejects.
+    header.codec = codec_from_name(std::string(line.substr(0, codec_end)));
+    line.remove_prefix(codec_end);
+    return take_number(line, header.raw_size) && take_number(line, header.compressed_size) && line.empty();
+}
+
+std::string RaftNode::handle_compressed_rpc(const CompressedFrameHeader& header, std::string_view body) {
+    // Decompress outside the lock, then handle the inner AppendEntries as usual.
+    std::string inner;
+    if (header.raw_size <= kMaxRpcPayloadBytes && body.size() == header.compressed_size &&
+        decompress_block(header.codec, body, header.raw_size, inner)) {
+        return handle_rpc(inner);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Not a log mismatch, so the leader must not back off next_index for it.
+    return "DecodeFail " + std::to_string(current_term_) + " codecs=" + supported_codecs_string() + "\n";
+}
+
+std::string RaftNode::handle_rpc(std::string_view request) {
+    if (request.rfind("AppendEntriesZ ", 0) == 0) {
+        size_t header_end = request.find('\n');
+        CompressedFrameHeader header;
+        if (header_end == std::string_view::npos || !parse_compressed_header(request.substr(0, header_end), header)) {
+            // A default header never decodes, so this answers DecodeFail.
+            return handle_compressed_rpc(CompressedFrameHeader(), {});
+        }
+        return handle_compressed_rpc(header, request.substr(header_end + 1));
+    }
+
     std::lock_guard<std::mutex> lock(mutex_);
-    std::stringstream ss(request);
+    if (request.rfind("AppendEntries ", 0) == 0) {
+        // Entries are decoded straight out of the request, without copying it into a stream.
+        return handle_append_entries(request.substr(sizeof("AppendEntries ") - 1));
+    }
+    // The remaining RPCs are a few short fields.
+    std::stringstream ss{std::string(request)};
     std::string rpc_type;
     ss >> rpc_type;
 
@@ -243,81 +504,180 @@ std::string RaftNode::handle_rpc(const std::string& request) {
         return "VoteDenied " + std::to_string(current_term_) + "\n";
     }
 
-    if (rpc_type == "AppendEntries") {
-        int term, leader_id, prev_log_index, prev_log_term, leader_commit;
-        ss >> term >> leader_id >> prev_log_index >> prev_log_term >> leader_commit;
-        
-        if (term > current_term_) step_down(term);
-        if (term < current_term_) return "Fail " + std::to_string(current_term_) + "\n";
-        
-        reset_election_timer();
-        if (state_ != RaftState::Follower) {
-           state_ = RaftState::Follower;
-        }
-        current_leader_id_ = leader_id;
+    if (rpc_type == "PreVote") {
+        // Answer "would you vote for me in this term?" without changing any state.
+        int term, candidate_id, last_log_index, last_log_term;
+        ss >> term >> candidate_id >> last_log_index >> last_log_term;
 
+        bool log_ok = (last_log_term > log_.back().term) || (last_log_term == log_.back().term && last_log_index >= (int)(log_.size() - 1));
 
-        if (log_.size() <= (size_t)prev_log_index || log_[prev_log_index].term != prev_log_term) {
-            return "Fail " + std::to_string(current_term_) + "\n";
+        if (term > current_term_ && log_ok && !heard_from_leader_recently()) {
+            return "PreVoteGranted " + std::to_string(current_term_) + "\n";
         }
+        return "PreVoteDenied " + std::to_string(current_term_) + "\n";
+    }
 
-        // Correctly parse multiple log entries, even with spaces in commands.
-        log_.erase(log_.begin() + prev_log_index + 1, log_.end());
+    if (rpc_type == "TimeoutNow") {
+        int term, leader_id;
+        ss >> term >> leader_id;
 
-        std::string entries_payload;
-        // Read the rest of the line, which contains the log entries.
-        std::getline(ss, entries_payload);
+        if (term < current_term_) return "Fail " + std::to_string(current_term_) + "\n";
 
-        std::stringstream entries_ss(entries_payload);
-        std::string single_entry_str;
-        // Split entries by our separator character.
-        while (std::getline(entries_ss, single_entry_str, '\x01')) {
-            if (single_entry_str.empty() || single_entry_str.find_first_not_of(' ') == std::string::npos) {
-                continue;
-            }
-            std::stringstream entry_ss(single_entry_str);
-            int entry_term;
-            entry_ss >> entry_term;
-            entry_ss >> std::ws; // skip whitespace
-            std::string entry_command;
-            std::getline(entry_ss, entry_command);
-            log_.push_back({entry_term, entry_command});
-        }
-        
-        if (leader_commit > commit_index_) {
-            commit_index_ = std::min(leader_commit, (int)log_.size() - 1);
-        }
+        // The leader has picked us as its successor: campaign immediately,
+        // skipping Pre-Vote since the other nodes still see a live leader.
+        std::cout << "[Node " << id_ << "] Received TimeoutNow from leader " << leader_id << "." << std::endl;
+        start_election();
+        return "Ack " + std::to_string(current_term_) + "\n";
+    }
 
-        while (last_applied_ < commit_index_) {
-            last_applied_++;
-            kv_store_.apply_command(log_[last_applied_].command);
-        }
+    return "UnknownRPC\n";
+}
 
-        return "Success " + std::to_string(current_term_) + "\n";
+std::string RaftNode::handle_append_entries(std::string_view args) {
+    // This function is called WITH THE MUTEX HELD.
+    int term, leader_id, prev_log_index, prev_log_term, leader_commit;
+    if (!take_number(args, term) || !take_number(args, leader_id) || !take_number(args, prev_log_index) ||
+        !take_number(args, prev_log_term) || !take_number(args, leader_commit)) {
+        return "UnknownRPC\n";
     }
-    return "UnknownRPC\n";
+
+    if (term > current_term_) step_down(term);
+    // Replies advertise the codecs we can decode so the leader can compress for us.
+    const std::string codecs = " codecs=" + supported_codecs_string();
+    if (term < current_term_) return "Fail " + std::to_string(current_term_) + codecs + "\n";
+
+    reset_election_timer();
+    if (state_ != RaftState::Follower) {
+       state_ = RaftState::Follower;
+    }
+    current_leader_id_ = leader_id;
+    last_leader_contact_ = std::chrono::steady_clock::now();
+
+    if (prev_log_index < 0 || log_.size() <= (size_t)prev_log_index || log_[prev_log_index].term != prev_log_term) {
+        return "Fail " + std::to_string(current_term_) + codecs + "\n";
+    }
+
+    // Each entry is "<term> <encoded command>"; decode them all before touching the log.
+    std::vector<LogEntry> entries;
+    while (!args.empty() && args.front() == ' ') {
+        LogEntry entry;
+        if (!take_number(args, entry.term) || args.empty() || args.front() != ' ') break;
+        args.remove_prefix(1);
+        if (!decode_command(args, entry.command)) break;
+        entries.push_back(std::move(entry));
+    }
+    if (!args.empty() && args != "\n") {
+        std::cerr << "[Node " << id_ << "] Malformed AppendEntries from leader " << leader_id << "." << std::endl;
+        return "Fail " + std::to_string(current_term_) + codecs + "\n";
+    }
+
+    log_.erase(log_.begin() + prev_log_index + 1, log_.end());
+    log_.insert(log_.end(), std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+
+    if (leader_commit > commit_index_) {
+        commit_index_ = std::min(leader_commit, (int)log_.size() - 1);
+    }
+
+    while (last_applied_ < commit_index_) {
+        last_applied_++;
+        kv_store_.apply(log_[last_applied_].command);
+    }
+
+    return "Success " + std::to_string(current_term_) + codecs + "\n";
 }
 
-void RaftNode::submit_command(const std::string& command, std::function<void(const std::string&)> callback) {
+void RaftNode::submit_command(const std::string& command, ReplyCallback callback) {
     std::lock_guard<std::mutex> lock(mutex_);
     if (state_ != RaftState::Leader) {
-        std::string response = "NOT_LEADER";
-        if (current_leader_id_ != -1 && current_leader_id_ < (int)peer_addresses_.size()) {
-            response += " " + peer_addresses_[current_leader_id_];
-        }
-        response += "\n";
-
+        std::string response = not_leader_response();
         boost::asio::post(io_context_, [callback, response]() { callback(response); });
         return;
     }
+    if (transfer_target_ != -1) {
+        // New entries would only delay the target catching up.
+        boost::asio::post(io_context_, [callback]() { callback("ERR leadership transfer in progress\n"); });
+        return;
+    }
+    Command parsed;
+    std::string error;
+    if (!parse_command(command, parsed, error)) {
+        // Nothing to replicate: invalid commands never reach the log.
+        boost::asio::post(io_context_, [callback, error]() { callback(error); });
+        return;
+    }
+    size_t uncommitted_entries = log_.size() - 1 - commit_index_;
+    if (uncommitted_entries >= options_.max_uncommitted_entries ||
+        uncommitted_bytes_ + parsed.payload.size() > options_.max_uncommitted_bytes) {
+        // Reject fast so latency stays bounded while followers catch up.
+        boost::asio::post(io_context_, [callback]() { callback("BUSY\n"); });
+        return;
+    }
+    if (parsed.op == OpCode::Set && kv_store_.eviction_policy() == EvictionPolicy::NoEviction &&
+        kv_store_.max_memory() != 0 && kv_store_.used_memory() > kv_store_.max_memory()) {
+        boost::asio::post(io_context_, [callback]() { callback("ERR OOM command not allowed when used memory > 'maxmemory'\n"); });
+        return;
+    }
 
-    log_.push_back({current_term_, command});
+    uncommitted_bytes_ += parsed.payload.size();
+    log_.push_back({current_term_, std::move(parsed)});
     int new_log_index = log_.size() - 1;
     client_callbacks_[new_log_index] = callback;
 
     std::cout << "[Node " << id_ << "] Leader received command: '" << command << "'. Appending at index " << new_log_index << "." << std::endl;
 }
 
+std::string RaftNode::info() {
+    std::string result;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        static const char* const kRoleNames[] = {"follower", "pre-candidate", "candidate", "leader"};
+        result = "role:" + std::string(kRoleNames[static_cast<int>(state_)]) + "\n" +
+                 "term:" + std::to_string(current_term_) + "\n" +
+                 "commit_index:" + std::to_string(commit_index_) + "\n" +
+                 "uncommitted_entries:" + std::to_string(log_.size() - 1 - commit_index_) + "\n";
+    }
+    return result + kv_store_.memory_info() + compression_stats().to_string();
+}
+
+void RaftNode::transfer_leadership(int target_id, ReplyCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ != RaftState::Leader) {
+        std::string response = not_leader_response();
+        boost::asio::post(io_context_, [callback, response]() { callback(response); });
+        return;
+    }
+    if (transfer_target_ != -1) {
+        boost::asio::post(io_context_, [callback]() { callback("ERR leadership transfer in progress\n"); });
+        return;
+    }
+
+    if (target_id == -1) {
+        // Pick the peer that needs the least catching up.
+        for (size_t i = 0; i < peer_addresses_.size(); ++i) {
+            if (i == (size_t)id_) continue;
+            if (target_id == -1 || match_index_[i] > match_index_[target_id]) {
+                target_id = i;
+            }
+        }
+    }
+    if (target_id < 0 || target_id >= (int)peer_addresses_.size() || target_id == id_) {
+        boost::asio::post(io_context_, [callback]() { callback("ERR invalid transfer target\n"); });
+        return;
+    }
+
+    std::cout << "[Node " << id_ << "] Transferring leadership to node " << target_id << "." << std::endl;
+    transfer_target_ = target_id;
+    timeout_now_sent_ = false;
+    transfer_deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(options_.election_timeout_max_ms);
+    transfer_callback_ = callback;
+
+    if (match_index_[target_id] == (int)log_.size() - 1) {
+        send_timeout_now(target_id);
+    } else {
+        send_append_entries(target_id);
+    }
+}
+
 void RaftNode::send_rpc(const std::string& peer_address, const std::string& rpc_message, std::function<void(const std::string&)> callback) {
     auto self = shared_from_this();
     boost::asio::co_spawn(io_context_, [this, self, peer_address, rpc_message, callback]() -> boost::asio::awaitable<void> {
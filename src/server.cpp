@@ -2,11 +2,15 @@
 #include "raft.h"
 #include "thread_pool.h"
 #include <boost/asio.hpp>
+#include <algorithm>
+#include <charconv>
+#include <deque>
 #include <filesystem>
 #include <iostream>
 #include <memory>
-#include <sstream>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <utility>
 #include <vector>
@@ -15,86 +19,317 @@ using boost::asio::ip::tcp;
 
 class Session : public std::enable_shared_from_this<Session> {
 public:
-    Session(tcp::socket socket, std::shared_ptr<RaftNode> raft_node)
-        : socket_(std::move(socket)), raft_node_(raft_node) {}
+    Session(tcp::socket socket, std::shared_ptr<RaftNode> raft_node, size_t max_in_flight)
+        : socket_(std::move(socket)), raft_node_(raft_node), max_in_flight_(max_in_flight) {}
 
     void start() { do_read(); }
 
 private:
+    // All handlers below run on the socket's strand, so session state needs no locking.
     void do_read() {
         auto self(shared_from_this());
         boost::asio::async_read_until(
             socket_, buffer_, "\n",
-            [this, self](boost::system::error_code ec, std::size_t) {
+            [this, self](boost::system::error_code ec, std::size_t length) {
                 if (!ec) {
-                    std::istream is(&buffer_);
-                    std::string line;
-                    std::getline(is, line);
+                    // View the line in place in the read buffer; it is consumed once dispatched.
+                    std::string_view line(static_cast<const char*>(buffer_.data().data()), length - 1);
                     // Remove potential carriage return
-                    if (!line.empty() && line.back() == '\r') line.pop_back();
-
-                    std::stringstream ss(line);
-                    std::string first_word;
-                    ss >> first_word;
-                    
-                    if (first_word == "RequestVote" || first_word == "AppendEntries") {
-                        std::string response = raft_node_->handle_rpc(line + "\n");
-                        do_write(response, false); 
+                    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                    std::string_view first_word = line.substr(0, line.find(' '));
+
+                    // Peer RPC connections carry a single request, so stop reading after it.
+                    if (first_word == "RequestVote" || first_word == "AppendEntries" ||
+                        first_word == "PreVote" || first_word == "TimeoutNow") {
+                        std::string reply = raft_node_->handle_rpc(line);
+                        buffer_.consume(length);
+                        complete(next_reply_slot(), std::move(reply));
+                        return;
+                    } else if (first_word == "AppendEntriesZ") {
+                        RaftNode::CompressedFrameHeader header;
+                        bool valid = RaftNode::parse_compressed_header(line, header) &&
+                                     header.compressed_size <= RaftNode::kMaxRpcPayloadBytes;
+                        buffer_.consume(length);
+                        if (valid) read_payload(header);
+                        return;
+                    } else if (first_word == "INFO") {
+                        complete(next_reply_slot(), raft_node_->info());
+                    } else if (first_word == "TRANSFER_LEADER") {
+                        int target_id = -1;
+                        if (parse_transfer_target(line.substr(first_word.size()), target_id)) {
+                            raft_node_->transfer_leadership(target_id, reply_to(next_reply_slot()));
+                        } else {
+                            complete(next_reply_slot(), "ERR invalid transfer target\n");
+                        }
                     } else {
                         // The callback ensures the reply is only sent after the command is committed.
-                        raft_node_->submit_command(line, [this, self](const std::string& response){
-                            do_write(response, true);
-                        });
+                        raft_node_->submit_command(std::string(line), reply_to(next_reply_slot()));
+                    }
+                    buffer_.consume(length);
+                    // Keep reading while earlier commands are still being replicated,
+                    // unless this client already has too many replies outstanding.
+                    if (pending_replies() < max_in_flight_) {
+                        do_read();
+                    } else {
+                        reading_paused_ = true;
                     }
                 }
             });
     }
 
-    void do_write(const std::string& response, bool keep_alive) {
+    // Reads the optional node id after TRANSFER_LEADER; a missing id leaves target_id at -1.
+    static bool parse_transfer_target(std::string_view arg, int& target_id) {
+        while (!arg.empty() && arg.front() == ' ') arg.remove_prefix(1);
+        while (!arg.empty() && arg.back() == ' ') arg.remove_suffix(1);
+        if (arg.empty()) return true;
+        auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), target_id);
+        return ec == std::errc() && ptr == arg.data() + arg.size();
+    }
+
+    // Reads the binary body that follows a framed RPC header line, then dispatches it.
+    // The body is decompressed straight out of the read buffer.
+    void read_payload(const RaftNode::CompressedFrameHeader& header) {
+        auto self(shared_from_this());
+        size_t size = header.compressed_size;
+        size_t missing = size > buffer_.size() ? size - buffer_.size() : 0;
+        boost::asio::async_read(
+            socket_, buffer_, boost::asio::transfer_exactly(missing),
+            [this, self, header, size](boost::system::error_code ec, std::size_t) {
+                if (!ec) {
+                    std::string_view body(static_cast<const char*>(buffer_.data().data()), size);
+                    std::string reply = raft_node_->handle_compressed_rpc(header, body);
+                    buffer_.consume(size);
+                    complete(next_reply_slot(), std::move(reply));
+                }
+            });
+    }
+
+    // Reserves the position of the next reply; replies go out in request order
+    // even though commands may complete out of order.
+    uint64_t next_reply_slot() {
+        replies_.emplace_back();
+        return next_slot_++;
+    }
+
+    // Wraps a reply slot so a Raft callback on any io thread completes it on the strand.
+    ReplyCallback reply_to(uint64_t slot) {
+        auto self(shared_from_this());
+        return [this, self, slot](std::string response) {
+            boost::asio::post(socket_.get_executor(), [this, self, slot, response = std::move(response)]() mutable {
+                complete(slot, std::move(response));
+            });
+        };
+    }
+
+    void complete(uint64_t slot, std::string response) {
+        // Replies spanning several lines (KEYS, INFO) start with "*<line count>",
+        // so a pipelining client knows where each reply ends.
+        size_t lines = std::count(response.begin(), response.end(), '\n');
+        if (lines > 1) response.insert(0, "*" + std::to_string(lines) + "\n");
+        replies_[slot - first_unsent_slot_] = std::move(response);
+        while (!replies_.empty() && replies_.front()) {
+            outbox_.push_back(std::move(*replies_.front()));
+            replies_.pop_front();
+            first_unsent_slot_++;
+        }
+        if (!writing_) do_write();
+    }
+
+    // Flushes every ready reply with one vectored write.
+    void do_write() {
+        if (outbox_.empty()) return;
+        writing_ = true;
+        in_flight_.swap(outbox_);
+        write_buffers_.clear();
+        for (const auto& reply : in_flight_) {
+            write_buffers_.push_back(boost::asio::buffer(reply));
+        }
+
         auto self(shared_from_this());
         boost::asio::async_write(
-            socket_, boost::asio::buffer(response),
-            [this, self, keep_alive](boost::system::error_code ec, std::size_t) {
-                if (!ec && keep_alive) {
-                    do_read();
+            socket_, write_buffers_,
+            [this, self](boost::system::error_code ec, std::size_t) {
+                writing_ = false;
+                in_flight_.clear();
+                if (!ec) {
+                    do_write();
+                    if (reading_paused_ && pending_replies() < max_in_flight_) {
+                        reading_paused_ = false;
+                        do_read();
+                    }
                 }
             });
     }
 
+    // Requests read from this client whose replies have not been written yet.
+    size_t pending_replies() const {
+        return replies_.size() + outbox_.size() + in_flight_.size();
+    }
+
     tcp::socket socket_;
     std::shared_ptr<RaftNode> raft_node_;
     boost::asio::streambuf buffer_;
+    size_t max_in_flight_;
+    bool reading_paused_{false};
+
+    // Reply slots from first_unsent_slot_ onwards; empty until that reply is ready.
+    std::deque<std::optional<std::string>> replies_;
+    uint64_t first_unsent_slot_{0};
+    uint64_t next_slot_{0};
+
+    // Ready replies waiting for the current write, and the batch being written.
+    // Both vectors keep their capacity across writes.
+    std::vector<std::string> outbox_;
+    std::vector<std::string> in_flight_;
+    std::vector<boost::asio::const_buffer> write_buffers_;
+    bool writing_{false};
 };
 
 class Server {
 public:
-    Server(boost::asio::io_context& io_context, short port, std::shared_ptr<RaftNode> raft_node)
-        : acceptor_(io_context, tcp::endpoint(tcp::v4(), port)), raft_node_(raft_node) {
+    Server(boost::asio::io_context& io_context, short port, std::shared_ptr<RaftNode> raft_node, size_t max_in_flight_per_session)
+        : io_context_(io_context), acceptor_(io_context, tcp::endpoint(tcp::v4(), port)), raft_node_(raft_node),
+          max_in_flight_per_session_(max_in_flight_per_session) {
         do_accept();
     }
 private:
     void do_accept() {
-        acceptor_.async_accept([this](boost::system::error_code ec, tcp::socket socket) {
+        // Each session gets its own strand so its reads, writes and replies never run concurrently.
+        acceptor_.async_accept(boost::asio::make_strand(io_context_), [this](boost::system::error_code ec, tcp::socket socket) {
             if (!ec) {
-                std::make_shared<Session>(std::move(socket), raft_node_)->start();
+                std::make_shared<Session>(std::move(socket), raft_node_, max_in_flight_per_session_)->start();
             }
             do_accept();
         });
     }
+    boost::asio::io_context& io_context_;
     tcp::acceptor acceptor_;
     std::shared_ptr<RaftNode> raft_node_;
+    size_t max_in_flight_per_session_;
 };
 
+// Parses the whole of value as a number of type T; throws std::invalid_argument
+// on trailing characters, overflow, or a sign where T is unsigned.
+template <typename T>
+T parse_number(std::string_view value) {
+    T result{};
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec != std::errc() || ptr != value.data() + value.size()) {
+        throw std::invalid_argument("not a number: " + std::string(value));
+    }
+    return result;
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <my_id> <peer0_addr> [peer1_addr] ...\n"
+              << "Options:\n"
+              << "  --election-timeout=<min_ms>[-<max_ms>] Randomized election timeout (default 300-500);\n"
+              << "                                         a single value means <min_ms>-<2*min_ms>\n"
+              << "  --heartbeat-interval=<ms>              Leader heartbeat interval (default 150)\n"
+              << "  --no-pre-vote                          Disable the Pre-Vote round\n"
+              << "  --no-check-quorum                      Keep leading without a reachable majority\n"
+              << "  --compression=<zstd|zlib|none>         Preferred AppendEntries codec (default zstd,\n"
+              << "                                         falls back to what both peers support)\n"
+              << "  --compression-threshold=<bytes>        Minimum payload size to compress (default 4096)\n"
+              << "  --max-uncommitted-entries=<n>          Answer BUSY past this many uncommitted entries (default 10000)\n"
+              << "  --max-uncommitted-bytes=<bytes>        Answer BUSY past this many uncommitted bytes (default 64 MiB)\n"
+              << "  --max-inflight-per-session=<n>         Stop reading from a client with this many replies\n"
+              << "                                         outstanding (default 1024)\n"
+              << "  --maxmemory=<bytes>                    Store memory budget, 0 for unlimited (default 0)\n"
+              << "  --maxmemory-policy=<policy>            noeviction, allkeys-lru or allkeys-lfu (default noeviction)\n";
+}
+
+struct ServerOptions {
+    RaftOptions raft;
+    size_t max_in_flight_per_session = 1024;
+    size_t max_memory = 0;
+    EvictionPolicy eviction_policy = EvictionPolicy::NoEviction;
+};
+
+// Consumes "--" options into ServerOptions and returns the remaining positional arguments.
+// Throws on an unknown option or a malformed value.
+std::vector<std::string> parse_options(int argc, char* argv[], ServerOptions& server_options) {
+    RaftOptions& options = server_options.raft;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            positional.push_back(arg);
+            continue;
+        }
+        size_t eq_pos = arg.find('=');
+        std::string name = arg.substr(0, eq_pos);
+        std::string value = eq_pos == std::string::npos ? "" : arg.substr(eq_pos + 1);
+
+        try {
+            if (name == "--election-timeout") {
+                std::string_view range(value);
+                size_t dash_pos = range.find('-');
+                options.election_timeout_min_ms = parse_number<int>(range.substr(0, dash_pos));
+                options.election_timeout_max_ms = dash_pos == std::string_view::npos
+                    ? options.election_timeout_min_ms * 2
+                    : parse_number<int>(range.substr(dash_pos + 1));
+            } else if (name == "--heartbeat-interval") {
+                options.heartbeat_interval_ms = parse_number<int>(value);
+            } else if (name == "--no-pre-vote") {
+                options.pre_vote = false;
+            } else if (name == "--no-check-quorum") {
+                options.check_quorum = false;
+            } else if (name == "--compression") {
+                options.compression = codec_from_name(value);
+                if (options.compression == Codec::None && value != "none") {
+                    throw std::invalid_argument("unknown codec " + value);
+                }
+            } else if (name == "--compression-threshold") {
+                options.compression_threshold_bytes = parse_number<size_t>(value);
+            } else if (name == "--max-uncommitted-entries") {
+                options.max_uncommitted_entries = parse_number<size_t>(value);
+            } else if (name == "--max-uncommitted-bytes") {
+                options.max_uncommitted_bytes = parse_number<size_t>(value);
+            } else if (name == "--max-inflight-per-session") {
+                server_options.max_in_flight_per_session = parse_number<size_t>(value);
+            } else if (name == "--maxmemory") {
+                server_options.max_memory = parse_number<size_t>(value);
+            } else if (name == "--maxmemory-policy") {
+                if (!eviction_policy_from_name(value, server_options.eviction_policy)) {
+                    throw std::invalid_argument("unknown maxmemory policy " + value);
+                }
+            } else {
+                throw std::runtime_error("unknown option " + arg);
+            }
+        } catch (const std::logic_error&) {
+            // Malformed numbers, and the unknown-name checks above.
+            throw std::invalid_argument("invalid value '" + value + "' for " + name);
+        }
+    }
+    if (options.election_timeout_min_ms <= 0 || options.election_timeout_max_ms < options.election_timeout_min_ms ||
+        options.heartbeat_interval_ms <= 0 || options.heartbeat_interval_ms >= options.election_timeout_min_ms) {
+        throw std::invalid_argument("heartbeat interval must be positive and below the election timeout range");
+    }
+    if (options.max_uncommitted_entries == 0 || options.max_uncommitted_bytes == 0 || server_options.max_in_flight_per_session == 0) {
+        throw std::invalid_argument("admission limits must be positive");
+    }
+    return positional;
+}
+
 int main(int argc, char* argv[]) {
     try {
-        if (argc < 3) {
-            std::cerr << "Usage: " << argv[0] << " <my_id> <peer0_addr> [peer1_addr] ...\n";
+        ServerOptions options;
+        std::vector<std::string> args;
+        try {
+            args = parse_options(argc, argv, options);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (args.size() < 2) {
+            print_usage(argv[0]);
             return 1;
         }
 
-        int my_id = std::stoi(argv[1]);
-        std::vector<std::string> peer_addresses;
-        for (int i = 2; i < argc; ++i) peer_addresses.push_back(argv[i]);
+        int my_id = std::stoi(args[0]);
+        std::vector<std::string> peer_addresses(args.begin() + 1, args.end());
 
         if (my_id < 0 || my_id >= (int)peer_addresses.size()) {
             std::cerr << "Error: my_id is out of range.\n";
@@ -115,9 +350,10 @@ int main(int argc, char* argv[]) {
         std::filesystem::create_directory("AOFs");
 
         KeyValueStore kv_store("AOFs/node_" + std::to_string(my_id) + ".aof");
-        auto raft_node = std::make_shared<RaftNode>(my_id, peer_addresses, kv_store, io_context);
+        kv_store.set_memory_limit(options.max_memory, options.eviction_policy);
+        auto raft_node = std::make_shared<RaftNode>(my_id, peer_addresses, kv_store, io_context, options.raft);
         
-        Server server(io_context, port, raft_node);
+        Server server(io_context, port, raft_node, options.max_in_flight_per_session);
         std::cout << "Server listening on port " << port << "..." << std::endl;
         
         raft_node->start();